@@ -1,19 +1,126 @@
+#if defined(_WIN32)
 #define _WIN32_WINNT 0x0601
-
 #include <windows.h>
+#ifndef ENABLE_VIRTUAL_TERMINAL_PROCESSING
+#define ENABLE_VIRTUAL_TERMINAL_PROCESSING 0x0004
+#endif
+#endif
 #include <iostream>
 #include <iomanip>
 #include <string>
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <array>
+#include <bitset>
+#include <atomic>
+#include <deque>
+#include <set>
+#include <map>
+#include <unordered_map>
 #include <algorithm>
 #include <stdexcept>
 #include <cctype>
+#include <climits>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <chrono>
+#include <random>
+#include <thread>
+#include <mutex>
+#include <functional>
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
 
 using namespace std;
 
-void irPara(short x, short y);
+void irPara(int x, int y);
+void pausar();
+
+// Quadro de texto do modo interativo. mostrarEstado escreve em 'saida' depois
+// de posicionar o cursor com irPara; apresentar compara o quadro montado com o
+// do ciclo anterior (shadow frame buffer) e envia ao terminal, com sequências
+// ANSI, só os trechos de cada linha que mudaram.
+struct Tela {
+    ostringstream saida;
+    vector<string> quadro;    // quadro em montagem
+    vector<string> anterior;  // o que está no terminal
+    int x = 0, y = 0;
+
+    void posicionar(int nx, int ny) {
+        descarregar();
+        x = nx;
+        y = ny;
+    }
+
+    // Copia para o quadro, a partir do cursor, o texto escrito em 'saida'.
+    // Texto em posição negativa fica fora do quadro e é descartado.
+    void descarregar() {
+        string texto = saida.str();
+        saida.str("");
+        for (char c : texto) {
+            if (c == '\n') {
+                y++;
+                x = 0;
+                continue;
+            }
+            if (x < 0 || y < 0) {
+                x++;
+                continue;
+            }
+            if ((int)quadro.size() <= y) quadro.resize(y + 1);
+            string& linha = quadro[y];
+            if ((int)linha.size() <= x) linha.resize(x + 1, ' ');
+            linha[x++] = c;
+        }
+    }
+
+    // Envia as diferenças para o terminal e deixa o cursor no fim do quadro.
+    // Trechos alterados separados por poucas células iguais vão numa só escrita.
+    void apresentar() {
+        const size_t JUNTAR = 8;
+        descarregar();
+        string s;
+        if (anterior.empty()) s += "\x1b[2J";
+        size_t linhas = max(quadro.size(), anterior.size());
+        string vazia;
+        for (size_t l = 0; l < linhas; l++) {
+            const string& nova = l < quadro.size() ? quadro[l] : vazia;
+            const string& velha = l < anterior.size() ? anterior[l] : vazia;
+            if (nova == velha) continue;
+            auto difere = [&](size_t i) { return i >= velha.size() || nova[i] != velha[i]; };
+            size_t i = 0;
+            while (i < nova.size()) {
+                if (!difere(i)) {
+                    i++;
+                    continue;
+                }
+                size_t fim = i + 1, j = i + 1;
+                while (j < nova.size() && j - fim < JUNTAR) {
+                    if (difere(j)) fim = j + 1;
+                    j++;
+                }
+                s += "\x1b[" + to_string(l + 1) + ";" + to_string(i + 1) + "H" + nova.substr(i, fim - i);
+                i = fim;
+            }
+            if (velha.size() > nova.size())
+                s += "\x1b[" + to_string(l + 1) + ";" + to_string(nova.size() + 1) + "H\x1b[K";
+        }
+        s += "\x1b[" + to_string(y + 1) + ";" + to_string(x + 1) + "H";
+        cout << s << flush;
+        anterior.swap(quadro);
+        quadro.clear();
+        x = y = 0;
+    }
+};
+
+Tela tela;
 
 // Registrador simples: nome e valor
 struct Registrador {
@@ -23,36 +130,264 @@ struct Registrador {
     bool operator==(const Registrador& r) const { return nome == r.nome; }
 };
 
-vector<Registrador> registradores; // F0..Fn
-vector<Registrador> memoria;       // memória simulada: par (endereco como string, valor)
+// Arquivo mapeado em memória (copy-on-write: escritas não voltam ao arquivo)
+struct ArquivoMapeado {
+    void* base = nullptr;
+    size_t bytes = 0;
+#if defined(_WIN32)
+    HANDLE arquivo;
+    HANDLE mapa;
+#endif
 
-// Funções auxiliares globais
-int obterValorRegistrador(const string& nomeReg) {
-    for (const auto& r : registradores)
-        if (r.nome == nomeReg) return r.valor;
-    return 0;
-}
+    bool abrir(const string& nomeArquivo, string& erro) {
+#if defined(_WIN32)
+        arquivo = CreateFileA(nomeArquivo.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr,
+                              OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+        if (arquivo == INVALID_HANDLE_VALUE) { erro = "arquivo nao pode ser aberto"; return false; }
+        LARGE_INTEGER tam;
+        if (!GetFileSizeEx(arquivo, &tam)) { CloseHandle(arquivo); erro = "arquivo nao pode ser aberto"; return false; }
+        bytes = (size_t)tam.QuadPart;
+        if (bytes == 0) { CloseHandle(arquivo); erro = "arquivo vazio"; return false; }
+        mapa = CreateFileMappingA(arquivo, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+        base = mapa ? MapViewOfFile(mapa, FILE_MAP_COPY, 0, 0, 0) : nullptr;
+        if (!base) {
+            if (mapa) CloseHandle(mapa);
+            CloseHandle(arquivo);
+            erro = "falha no mapeamento";
+            return false;
+        }
+#else
+        int fd = open(nomeArquivo.c_str(), O_RDONLY);
+        if (fd < 0) { erro = "arquivo nao pode ser aberto"; return false; }
+        struct stat st;
+        if (fstat(fd, &st) < 0) { close(fd); erro = "arquivo nao pode ser aberto"; return false; }
+        bytes = (size_t)st.st_size;
+        if (bytes == 0) { close(fd); erro = "arquivo vazio"; return false; }
+        base = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (base == MAP_FAILED) { base = nullptr; erro = "falha no mapeamento"; return false; }
+#endif
+        return true;
+    }
 
-int lerMemoria(int endereco) {
-    string k = to_string(endereco);
-    for (const auto& m : memoria)
-        if (m.nome == k) return m.valor;
-    return 0;
-}
+    void fechar() {
+        if (!base) return;
+#if defined(_WIN32)
+        UnmapViewOfFile(base);
+        CloseHandle(mapa);
+        CloseHandle(arquivo);
+#else
+        munmap(base, bytes);
+#endif
+        base = nullptr;
+    }
+};
 
-void escreverMemoria(int endereco, int valor) {
-    string k = to_string(endereco);
-    for (auto& m : memoria) {
-        if (m.nome == k) {
-            m.valor = valor;
-            return;
+// Registro de desfazer do depurador: antes de cada escrita em estado grande
+// (memória, registradores, tabelas), guarda o endereço e os bytes anteriores.
+// Desfeito de trás para frente, devolve o estado de antes das escritas. Os
+// endereços anotados não mudam durante a simulação (páginas e tabelas só são
+// liberadas no fim).
+struct RegistroEscritas {
+    string dados; // (ponteiro, tamanho, bytes anteriores) em sequência
+
+    void anotar(const void* p, uint32_t n) {
+        dados.append((const char*)&p, sizeof(p));
+        dados.append((const char*)&n, sizeof(n));
+        dados.append((const char*)p, n);
+    }
+
+    static void desfazer(const string& registro) {
+        vector<size_t> inicios;
+        for (size_t pos = 0; pos < registro.size();) {
+            inicios.push_back(pos);
+            uint32_t n;
+            memcpy(&n, registro.data() + pos + sizeof(void*), sizeof(n));
+            pos += sizeof(void*) + sizeof(n) + n;
+        }
+        for (size_t k = inicios.size(); k-- > 0;) {
+            const char* e = registro.data() + inicios[k];
+            void* p;
+            uint32_t n;
+            memcpy(&p, e, sizeof(p));
+            memcpy(&n, e + sizeof(p), sizeof(n));
+            memcpy(p, e + sizeof(p) + sizeof(n), n);
         }
     }
-    Registrador r;
-    r.nome = k;
-    r.valor = valor;
-    memoria.push_back(r);
-}
+};
+
+// Memória simulada esparsa: espaço de 32 bits em palavras, dividido em páginas
+// de 4 KiB (1024 palavras) alocadas no primeiro toque. A tabela de páginas tem
+// dois níveis (diretório -> tabela -> página), então leitura e escrita são O(1).
+struct Memoria {
+    static const int BITS_PAGINA = 10;                   // 1024 palavras = 4 KiB
+    static const int BITS_TABELA = 11;
+    static const int PALAVRAS_PAGINA = 1 << BITS_PAGINA;
+    static const int ENTRADAS_TABELA = 1 << BITS_TABELA;
+    static const int ENTRADAS_DIRETORIO = 1 << (32 - BITS_PAGINA - BITS_TABELA);
+
+    struct Pagina {
+        int* valores;   // própria (new[]) ou apontando para uma imagem mapeada
+        bool propria;
+        uint64_t tocadas[PALAVRAS_PAGINA / 64]; // celulas escritas (para exibição)
+        Pagina() : valores(new int[PALAVRAS_PAGINA]()), propria(true), tocadas() {}
+        explicit Pagina(int* mapeada) : valores(mapeada), propria(false), tocadas() {}
+        ~Pagina() { if (propria) delete[] valores; }
+    };
+
+    Pagina** diretorio[ENTRADAS_DIRETORIO];
+    vector<ArquivoMapeado> mapeamentos;
+    int numPaginas = 0;
+    unordered_map<int, int> originais; // valor mapeado antes da primeira escrita (para restaurar)
+    RegistroEscritas* escritas = nullptr; // depurador: anota o que cada escrita muda
+
+    Memoria() { memset(diretorio, 0, sizeof(diretorio)); }
+    Memoria(const Memoria&) = delete;
+    Memoria& operator=(const Memoria&) = delete;
+    ~Memoria() { limpar(); }
+
+    void limpar() {
+        for (int d = 0; d < ENTRADAS_DIRETORIO; d++) {
+            if (!diretorio[d]) continue;
+            for (int t = 0; t < ENTRADAS_TABELA; t++)
+                delete diretorio[d][t];
+            delete[] diretorio[d];
+            diretorio[d] = nullptr;
+        }
+        numPaginas = 0;
+        originais.clear();
+        for (ArquivoMapeado& m : mapeamentos) m.fechar();
+        mapeamentos.clear();
+    }
+
+    Pagina**& tabelaPara(uint32_t end) {
+        Pagina**& tabela = diretorio[end >> (BITS_PAGINA + BITS_TABELA)];
+        if (!tabela) {
+            tabela = new Pagina*[ENTRADAS_TABELA];
+            memset(tabela, 0, sizeof(Pagina*) * ENTRADAS_TABELA);
+        }
+        return tabela;
+    }
+
+    // Mapeia um arquivo de palavras int32 (ordem de bytes do host) a partir do
+    // endereço 'base', que deve ser múltiplo do tamanho de página. As páginas
+    // apontam direto para o mapeamento; nada é copiado nem interpretado.
+    bool mapearImagem(const string& nomeArquivo, int base, string& erro) {
+        if (base % PALAVRAS_PAGINA != 0) {
+            erro = "endereco base deve ser multiplo de " + to_string(PALAVRAS_PAGINA);
+            return false;
+        }
+        ArquivoMapeado m;
+        if (!m.abrir(nomeArquivo, erro)) return false;
+        size_t palavras = m.bytes / sizeof(int);
+        if ((uint64_t)(uint32_t)base + palavras > (1ULL << 32)) {
+            erro = "imagem ultrapassa o espaco de enderecamento";
+            m.fechar();
+            return false;
+        }
+        mapeamentos.push_back(m);
+
+        // A última página parcial também aponta para o mapeamento: o restante da
+        // página do SO após o fim do arquivo é preenchido com zeros.
+        int* dados = (int*)m.base;
+        for (size_t p = 0; p * PALAVRAS_PAGINA < palavras; p++) {
+            uint32_t end = (uint32_t)base + (uint32_t)(p * PALAVRAS_PAGINA);
+            Pagina*& pag = tabelaPara(end)[(end >> BITS_PAGINA) & (ENTRADAS_TABELA - 1)];
+            if (pag) { delete pag; numPaginas--; }
+            pag = new Pagina(dados + p * PALAVRAS_PAGINA);
+            numPaginas++;
+        }
+        return true;
+    }
+
+    Pagina* buscarPagina(uint32_t end) const {
+        Pagina** tabela = diretorio[end >> (BITS_PAGINA + BITS_TABELA)];
+        if (!tabela) return nullptr;
+        return tabela[(end >> BITS_PAGINA) & (ENTRADAS_TABELA - 1)];
+    }
+
+    Pagina* obterPagina(uint32_t end) {
+        Pagina*& pag = tabelaPara(end)[(end >> BITS_PAGINA) & (ENTRADAS_TABELA - 1)];
+        if (!pag) {
+            pag = new Pagina();
+            numPaginas++;
+        }
+        return pag;
+    }
+
+    int ler(int endereco) const {
+        uint32_t end = (uint32_t)endereco;
+        const Pagina* pag = buscarPagina(end);
+        return pag ? pag->valores[end & (PALAVRAS_PAGINA - 1)] : 0;
+    }
+
+    void escrever(int endereco, int valor) {
+        uint32_t end = (uint32_t)endereco;
+        Pagina* pag = obterPagina(end);
+        uint32_t off = end & (PALAVRAS_PAGINA - 1);
+        uint64_t bit = 1ULL << (off & 63);
+        if (!pag->propria && !(pag->tocadas[off >> 6] & bit)) originais[endereco] = pag->valores[off];
+        if (escritas) {
+            escritas->anotar(&pag->valores[off], sizeof(int));
+            escritas->anotar(&pag->tocadas[off >> 6], sizeof(uint64_t));
+        }
+        pag->valores[off] = valor;
+        pag->tocadas[off >> 6] |= bit;
+    }
+
+    // Volta ao conjunto de células escritas 'celulas' (na ordem de
+    // celulasTocadas): as escritas que não estão nele recuperam o valor de
+    // antes da primeira escrita e deixam de ser tocadas
+    void restaurarTocadas(const vector<pair<int, int>>& celulas) {
+        size_t k = 0;
+        for (const auto& c : celulasTocadas()) {
+            while (k < celulas.size() && (uint32_t)celulas[k].first < (uint32_t)c.first) k++;
+            if (k < celulas.size() && celulas[k].first == c.first) continue;
+            uint32_t end = (uint32_t)c.first, off = end & (PALAVRAS_PAGINA - 1);
+            Pagina* pag = buscarPagina(end);
+            pag->valores[off] = pag->propria ? 0 : originais[c.first];
+            pag->tocadas[off >> 6] &= ~(1ULL << (off & 63));
+        }
+        for (const auto& c : celulas) escrever(c.first, c.second);
+    }
+
+    // Quantidade de células escritas
+    size_t numTocadas() const {
+        size_t n = 0;
+        for (int d = 0; d < ENTRADAS_DIRETORIO; d++) {
+            if (!diretorio[d]) continue;
+            for (int t = 0; t < ENTRADAS_TABELA; t++)
+                if (diretorio[d][t])
+                    for (uint64_t bits : diretorio[d][t]->tocadas) n += bitset<64>(bits).count();
+        }
+        return n;
+    }
+
+    // Celulas escritas, em ordem crescente de endereço (sem sinal); no máximo
+    // 'limite' (as de menor endereço)
+    vector<pair<int, int>> celulasTocadas(size_t limite = SIZE_MAX) const {
+        vector<pair<int, int>> cel;
+        for (int d = 0; d < ENTRADAS_DIRETORIO; d++) {
+            if (!diretorio[d]) continue;
+            for (int t = 0; t < ENTRADAS_TABELA; t++) {
+                const Pagina* pag = diretorio[d][t];
+                if (!pag) continue;
+                uint32_t base = ((uint32_t)d << (BITS_PAGINA + BITS_TABELA)) |
+                                ((uint32_t)t << BITS_PAGINA);
+                for (int w = 0; w < PALAVRAS_PAGINA / 64; w++) {
+                    uint64_t bits = pag->tocadas[w];
+                    for (int b = 0; bits; b++, bits >>= 1)
+                        if (bits & 1) {
+                            if (cel.size() == limite) return cel;
+                            uint32_t off = (uint32_t)(w * 64 + b);
+                            cel.push_back({ (int)(base | off), pag->valores[off] });
+                        }
+                }
+            }
+        }
+        return cel;
+    }
+};
 
 // Marcações por instrução (ciclos)
 struct StatusInstrucao {
@@ -61,29 +396,53 @@ struct StatusInstrucao {
     int fimExecucao;
     int escritaResultado;
     int ciclosRestantesExecucao;
+    long long sequencia;  // número de sequência da instância: ordem de programa dinâmica
+    int ciclosEsperaCDB;  // ciclos entre o fim da execução e a escrita, esperando barramento
+    int commit;           // ciclo de commit no ROB (-1 sem ROB)
     StatusInstrucao() {
         emitido = inicioExecucao = fimExecucao = escritaResultado = ciclosRestantesExecucao = -1;
+        ciclosEsperaCDB = commit = -1;
+        sequencia = -1;
     }
 };
 
-// “Enums” textuais
+// Códigos de operação, decodificados uma vez na carga do programa
 struct TiposInstrucao {
-    static const string MULT;
-    static const string SUBT;
-    static const string SOMA;
-    static const string DIVI;
-    static const string CARREGA;
-    static const string BNE;
-    static const string ARMAZENA;
+    enum Codigo : uint8_t {
+        NOP,
+        SOMA,
+        SUBT,
+        MULT,
+        DIVI,
+        CARREGA,
+        ARMAZENA,
+        BNE,
+        BEQ,
+        SOMA_IMED,  // formas com imediato: Rd, Rs, imediato
+        SUBT_IMED,
+        MULT_IMED,
+        DIVI_IMED,
+        NUM_TIPOS
+    };
+};
+
+const char* const NOMES_TIPOS_INSTRUCAO[TiposInstrucao::NUM_TIPOS] = {
+    "NOP", "ADD", "SUB", "MUL", "DIV", "LOAD", "STORE", "BNE", "BEQ",
+    "ADDI", "SUBI", "MULI", "DIVI"
 };
 
-const string TiposInstrucao::MULT     = "MUL";
-const string TiposInstrucao::SUBT     = "SUB";
-const string TiposInstrucao::SOMA     = "ADD";
-const string TiposInstrucao::DIVI     = "DIV";
-const string TiposInstrucao::CARREGA  = "LOAD";
-const string TiposInstrucao::BNE      = "BNE";
-const string TiposInstrucao::ARMAZENA = "STORE";
+inline bool ehImediato(uint8_t tipo) {
+    return tipo >= TiposInstrucao::SOMA_IMED && tipo <= TiposInstrucao::DIVI_IMED;
+}
+
+inline bool ehDesvio(uint8_t tipo) {
+    return tipo == TiposInstrucao::BNE || tipo == TiposInstrucao::BEQ;
+}
+
+// Operação executada pela estação: a forma com imediato usa a mesma unidade
+inline uint8_t operacaoBase(uint8_t tipo) {
+    return ehImediato(tipo) ? tipo - TiposInstrucao::SOMA_IMED + TiposInstrucao::SOMA : tipo;
+}
 
 struct TipoEstacaoReserva {
     static const string ADIC_SUB;
@@ -101,317 +460,2571 @@ struct TipoBufferLS {
 const string TipoBufferLS::CARREGA = "LOAD";
 const string TipoBufferLS::ARMAZENA = "STORE";
 
-// Instrução genérica
+// Índice de registrador ausente no formato pré-decodificado (limita a 255 registradores)
+const uint8_t SEM_REGISTRADOR = 0xFF;
+
+// Instrução pré-decodificada: 8 bytes sem ponteiros, igual em memória e no
+// programa binário, que pode então ser usado direto do mapeamento
 struct Instrucao {
-    string tipoInstrucao;
-    string regDestino;   // Rd (R-type)
-    string regFonte1;    // Rs (base em LS; op1 em R-type/BNE)
-    string regFonte2;    // Rt (op2 em R-type/BNE; valor em STORE; destino em LOAD)
-    int offsetImediato;  // imediato L/S; deslocamento em BNE
-    StatusInstrucao status;
-    Instrucao() : offsetImediato(-1) {
-        tipoInstrucao = regDestino = regFonte1 = regFonte2 = "";
-    }
+    uint8_t tipoInstrucao; // TiposInstrucao::Codigo
+    uint8_t regDestino;    // Rd (R-type)
+    uint8_t regFonte1;     // Rs (base em LS; op1 em R-type/desvio)
+    uint8_t regFonte2;     // Rt (op2 em R-type/desvio; valor em STORE; destino em LOAD)
+    int32_t offsetImediato; // imediato L/S e ADDI...; deslocamento em BNE/BEQ
+};
+
+static_assert(sizeof(Instrucao) == 8 && is_trivially_copyable<Instrucao>::value,
+              "Instrucao deve ser POD de 8 bytes (formato do programa binario)");
+
+// Programa binário: cabeçalho seguido de numInstrucoes registros Instrucao,
+// na ordem de bytes do host
+struct CabecalhoPrograma {
+    char assinatura[8];
+    uint32_t versao;
+    uint32_t numInstrucoes;
 };
 
+const char ASSINATURA_PROGRAMA[8] = "TOMPROG";
+const uint32_t VERSAO_PROGRAMA = 1;
+
+// Tag de unidade produtora (indice em Tomasulo::nomesUnidades); -1 = valor pronto
+const int SEM_UNIDADE = -1;
+
 // Estado do file de registradores (quem vai escrever)
 struct EstadoRegistrador {
     string nomeRegistrador;
-    string unidadeEscritora; // tag da ER/Buffer
+    int unidadeEscritora; // tag da ER/Buffer (sem ROB)
+    int entradaROB;       // entrada do ROB que escreverá o registrador (com ROB)
+    EstadoRegistrador() : nomeRegistrador(""), unidadeEscritora(SEM_UNIDADE), entradaROB(-1) {}
+};
+
+// Registros das instâncias dinâmicas em voo, num anel do tamanho da janela
+// (estações + buffers, ou o ROB). Cada emissão pega o próximo registro livre a
+// partir do cursor; ao ser retirada, a instância devolve o registro, de modo
+// que laços longos rodam com memória limitada.
+struct PoolInstancias {
+    vector<StatusInstrucao> anel;
+    vector<char> emUso;
+    int cursor = 0;
+    int ocupadas = 0;
+
+    void iniciar(int tamanho) {
+        anel.assign(max(1, tamanho), StatusInstrucao());
+        emUso.assign(anel.size(), 0);
+        cursor = ocupadas = 0;
+    }
+
+    StatusInstrucao* alocar() {
+        if (ocupadas == (int)anel.size())
+            throw runtime_error("Pool de instancias esgotado");
+        while (emUso[cursor]) cursor = (cursor + 1) % (int)anel.size();
+        emUso[cursor] = 1;
+        ocupadas++;
+        StatusInstrucao* st = &anel[cursor];
+        cursor = (cursor + 1) % (int)anel.size();
+        *st = StatusInstrucao();
+        return st;
+    }
+
+    void liberar(StatusInstrucao* st) {
+        emUso[st - anel.data()] = 0;
+        ocupadas--;
+    }
+};
+
+// Estatísticas acumuladas das instâncias retiradas
+struct EstatisticasRetiradas {
+    long long instancias = 0;
+    long long somaEsperaOperandos = 0; // emissão -> início da execução
+    long long somaExecucao = 0;        // início -> fim da execução
+    long long somaAteEscrita = 0;      // emissão -> escrita (gravação, no STORE)
+
+    void registrar(const StatusInstrucao& st) {
+        instancias++;
+        if (st.inicioExecucao == -1) return;
+        somaEsperaOperandos += st.inicioExecucao - st.emitido;
+        somaExecucao += st.fimExecucao - st.inicioExecucao + 1;
+        somaAteEscrita += st.escritaResultado - st.emitido;
+    }
+};
+
+struct BufferLoad;
+struct BufferStore;
+
+// Consumidor aguardando uma tag: campos Q e V a atualizar no broadcast. Na
+// base de um LOAD/STORE, o buffer é avisado para ganhar endereço na FilaLoadStore.
+struct Dependente {
+    int* origem;
+    int* valor;
+    BufferLoad* baseLoad = nullptr;
+    BufferStore* baseStore = nullptr;
+    bool dadoStore = false;   // valor de um STORE (muda o forwarding dos LOADs)
 };
 
 // Estação de reserva genérica (usa também para BNE)
 struct EstacaoReserva {
     string nome;
+    int id;       // tag da estacao
     bool ocupado;
-    string tipoInstrucao; // "ADD","SUB","MUL","DIV","BNE"
+    uint8_t tipoInstrucao; // SOMA, SUBT, MULT, DIVI, BNE ou BEQ
     int valorJ;  // Vj (literal quando pronto)
     int valorK;  // Vk (literal quando pronto)
-    string origemJ; // Qj (tag)
-    string origemK; // Qk (tag)
+    int origemJ; // Qj (tag)
+    int origemK; // Qk (tag)
     int destReg;    // índice do registrador destino (para R-type)
-    Instrucao *instrucao;
+    const Instrucao* instrucao;
+    StatusInstrucao* status;  // registro da instância em execução (PoolInstancias)
+    int entradaROB;           // entrada do ROB (-1 sem ROB)
     int ciclosRestantes;
     EstacaoReserva()
-        : nome(""), ocupado(false), tipoInstrucao(""),
-          valorJ(0), valorK(0), origemJ(""), origemK(""),
-          destReg(-1), instrucao(nullptr), ciclosRestantes(-1) {}
+        : nome(""), id(SEM_UNIDADE), ocupado(false), tipoInstrucao(TiposInstrucao::NOP),
+          valorJ(0), valorK(0), origemJ(SEM_UNIDADE), origemK(SEM_UNIDADE),
+          destReg(-1), instrucao(nullptr), status(nullptr), entradaROB(-1),
+          ciclosRestantes(-1) {}
 };
 
 // Buffers de LOAD
 struct BufferLoad {
     string nome;
+    int id;
     bool ocupado;
     int baseVal;      // valor numérico quando pronto
-    string origemBase; // tag do produtor da base
+    int origemBase;   // tag do produtor da base
     int offset;
     int destReg;      // índice do registrador destino
     int ciclosRestantes;
+    int latencia;     // ciclos do acesso (Load_Store_Cycles, ou da hierarquia de caches)
+    int fimEspera;    // último ciclo do acesso gasto em fila de porta/MSHR/banco
     bool resultReady;
     int resultado;
     bool hasForward;
     int forwardVal;
-    Instrucao* instrucao;
+    const Instrucao* instrucao;
+    StatusInstrucao* status;
+    int entradaROB;
+    bool naFila;            // na fila de LOAD/STORE (ainda não leu a memória)
+    bool enderecoIndexado;
+    int endereco;
+    bool especulativo;      // passou à frente de STORE sem endereço
+    long long ordemFonte;   // sequência do STORE de onde veio o forwarding (-1 = memória)
+    bool esperaStore;       // bloqueado por STORE mais antigo (ver avaliarLoad)
     BufferLoad()
-        : nome(""), ocupado(false), baseVal(0), origemBase(""),
-          offset(0), destReg(-1), ciclosRestantes(-1),
+        : nome(""), id(SEM_UNIDADE), ocupado(false), baseVal(0), origemBase(SEM_UNIDADE),
+          offset(0), destReg(-1), ciclosRestantes(-1), latencia(0), fimEspera(-1),
           resultReady(false), resultado(0),
           hasForward(false), forwardVal(0),
-          instrucao(nullptr) {}
+          instrucao(nullptr), status(nullptr), entradaROB(-1), naFila(false),
+          enderecoIndexado(false), endereco(0), especulativo(false), ordemFonte(-1),
+          esperaStore(false) {}
 };
 
 // Buffers de STORE
 struct BufferStore {
     string nome;
+    int id;
     bool ocupado;
     int baseVal;
-    string origemBase;
+    int origemBase;
     int offset;
     int value;
-    string origemVal;
+    int origemVal;
     int ciclosRestantes;
-    Instrucao* instrucao;
+    int fimEspera;    // último ciclo do acesso gasto em fila de porta/MSHR/banco
+    const Instrucao* instrucao;
+    StatusInstrucao* status;
+    int entradaROB;
+    bool enderecoIndexado;
+    int endereco;
     BufferStore()
-        : nome(""), ocupado(false), baseVal(0), origemBase(""),
-          offset(0), value(0), origemVal(""),
-          ciclosRestantes(-1), instrucao(nullptr) {}
+        : nome(""), id(SEM_UNIDADE), ocupado(false), baseVal(0), origemBase(SEM_UNIDADE),
+          offset(0), value(0), origemVal(SEM_UNIDADE),
+          ciclosRestantes(-1), fimEspera(-1), instrucao(nullptr), status(nullptr), entradaROB(-1),
+          enderecoIndexado(false), endereco(0) {}
 };
 
-// Núcleo do simulador
-struct Tomasulo {
-    string logEventos;
-    int cicloAtual = 0;
-
-    BufferLoad*  buffersCarregamento   = nullptr;
-    BufferStore* buffersArmazenamento  = nullptr;
-    EstacaoReserva* estacoesAddSub     = nullptr;
-    EstacaoReserva* estacoesMultDiv    = nullptr;
-    EstadoRegistrador* estadoRegistradores = nullptr;
-
-    int numBuffersCarregamento = 0;
-    int numBuffersArmazenamento = 0;
-    int numEstacoesAddSub = 0;
-    int numEstacoesMultDiv = 0;
+// Fila de LOAD/STORE para desambiguação de memória. Assim que a base é
+// resolvida, LOADs e STOREs são indexados pelo endereço: um LOAD só examina os
+// STOREs do mesmo endereço (aliases reais), e os ainda sem endereço ficam
+// ordenados pela ordem de emissão. Os LOADs que ainda não leram a memória são
+// indexados da mesma forma, para que um STORE não grave antes de um LOAD mais
+// antigo do mesmo endereço (WAR). Nada é varrido por ciclo: a base chega pelo
+// broadcast do CDB (Dependente) e os STOREs prontos ficam em ordem de programa.
+struct FilaLoadStore {
+    map<long long, BufferStore*> storesProntos;                // execução terminada
+    unordered_map<int, vector<BufferStore*>> storesPorEndereco;
+    map<long long, BufferStore*> storesSemEndereco;            // base pendente
+    unordered_map<int, vector<BufferLoad*>> loadsPorEndereco;
+    map<long long, BufferLoad*> loadsSemEndereco;
+    vector<BufferLoad*> loadsComBase;   // base recebida no CDB neste ciclo
+    vector<BufferStore*> storesComBase;
+    bool loadsDesatualizados = false;   // base de LOAD ou STORE mudou: reavaliar LOADs
+
+    template <typename T>
+    static void retirar(unordered_map<int, vector<T*>>& indice, int endereco, T* x) {
+        auto pos = indice.find(endereco);
+        vector<T*>& v = pos->second;
+        v.erase(find(v.begin(), v.end(), x));
+        if (v.empty()) indice.erase(pos);
+    }
 
-    int numTotalRegistradores = 0;
-    Instrucao* instrucoes = nullptr;
-    int numInstrucoes = 0;
+    void indexar(BufferLoad* lb) {
+        lb->endereco = lb->baseVal + lb->offset;
+        lb->enderecoIndexado = true;
+        loadsPorEndereco[lb->endereco].push_back(lb);
+    }
 
-    int ciclosLS = 1;
-    int ciclosAddSub = 1;
-    int ciclosMult = 1;
-    int ciclosDiv = 1;
+    // LOAD recém-emitido: fica na fila até ler a memória
+    void inserir(BufferLoad* lb) {
+        lb->naFila = true;
+        if (lb->origemBase == SEM_UNIDADE) {
+            indexar(lb);
+        } else {
+            loadsSemEndereco[lb->status->sequencia] = lb;
+        }
+    }
 
-    int cdb_rr = 0; // 0=ADD/SUB/BNE, 1=MUL/DIV, 2=LOAD
+    void remover(BufferLoad* lb) {
+        if (!lb->naFila) return;
+        if (lb->enderecoIndexado) {
+            retirar(loadsPorEndereco, lb->endereco, lb);
+            lb->enderecoIndexado = false;
+        } else {
+            loadsSemEndereco.erase(lb->status->sequencia);
+        }
+        lb->naFila = false;
+    }
 
-    bool branchPending = false;
-    bool branchResolved = false;
-    bool branchTaken = false;
-    int branchTarget = -1;
-    int branchIssuedIndex = -1;
+    // O STORE ainda não pode gravar: um LOAD mais antigo pode ler o mesmo
+    // endereço (WAR) ou um STORE mais antigo pode gravá-lo (WAW)
+    bool storeBloqueado(const BufferStore* sb) const {
+        long long ordem = sb->status->sequencia;
+        if (!loadsSemEndereco.empty() && loadsSemEndereco.begin()->first < ordem) return true;
+        if (haStoreAntigoSemEndereco(ordem)) return true;
+        auto pl = loadsPorEndereco.find(sb->endereco);
+        if (pl != loadsPorEndereco.end())
+            for (const BufferLoad* lb : pl->second)
+                if (lb->status->sequencia < ordem) return true;
+        auto ps = storesPorEndereco.find(sb->endereco);
+        if (ps != storesPorEndereco.end())
+            for (const BufferStore* st : ps->second)
+                if (st->status->sequencia < ordem) return true;
+        return false;
+    }
 
-    int eNumero(const string& s) const {
-        return all_of(s.begin(), s.end(),
-                      [](unsigned char c){ return std::isdigit(c); }) ? 1 : 0;
+    void indexar(BufferStore* sb) {
+        sb->endereco = sb->baseVal + sb->offset;
+        sb->enderecoIndexado = true;
+        storesPorEndereco[sb->endereco].push_back(sb);
     }
 
-    static int obterValorOperando(const string& operando) {
-        if (operando.empty()) return 0;
-        try { return stoi(operando); }
-        catch (...) { return 0; }
+    // STORE recém-emitido (base e offset já lidos)
+    void inserir(BufferStore* sb) {
+        if (sb->origemBase == SEM_UNIDADE) {
+            indexar(sb);
+        } else {
+            storesSemEndereco[sb->status->sequencia] = sb;
+        }
     }
 
-    static bool isValueReadyString(const string& s) {
-        if (s.empty()) return false;
-        size_t i = (s[0] == '+' || s[0] == '-') ? 1 : 0;
-        if (i >= s.size()) return false;
-        return all_of(s.begin() + i, s.end(),
-                      [](unsigned char c){ return std::isdigit(c); });
+    // STORE que terminou a execução: aguarda a vez de gravar
+    void pronto(BufferStore* sb) {
+        storesProntos[sb->status->sequencia] = sb;
     }
 
-    int regIndex(const string& r) const {
-        if (r.size() < 2 || (r[0] != 'F' && r[0] != 'f')) return -1;
-        int n = atoi(r.c_str() + 1);
-        if (n < 0 || n >= numTotalRegistradores) return -1;
-        return n;
+    // Indexa os LOADs/STOREs cuja base chegou pelo CDB neste ciclo (avisados em
+    // loadsComBase/storesComBase); devolve, em ordem de programa, os STOREs que
+    // acabaram de ganhar endereço. Os descartados no meio do ciclo são ignorados.
+    vector<BufferStore*> resolverEnderecos() {
+        auto maisAntigo = [](auto* a, auto* b) { return a->status->sequencia < b->status->sequencia; };
+        sort(loadsComBase.begin(), loadsComBase.end(), maisAntigo);
+        for (BufferLoad* lb : loadsComBase) {
+            if (!lb->ocupado || !lb->naFila || lb->enderecoIndexado) continue;
+            loadsSemEndereco.erase(lb->status->sequencia);
+            indexar(lb);
+        }
+        loadsComBase.clear();
+
+        vector<BufferStore*> resolvidos;
+        sort(storesComBase.begin(), storesComBase.end(), maisAntigo);
+        for (BufferStore* sb : storesComBase) {
+            if (!sb->ocupado || sb->enderecoIndexado) continue;
+            storesSemEndereco.erase(sb->status->sequencia);
+            indexar(sb);
+            resolvidos.push_back(sb);
+        }
+        storesComBase.clear();
+        return resolvidos;
     }
 
-    void carregarDadosDoArquivo(const string& nomeArquivo) {
-        ifstream leitura(nomeArquivo);
-        if (!leitura.is_open()) {
-            cout << "O arquivo de entrada nao pode ser aberto: " << nomeArquivo << endl;
-            system("pause");
-            exit(EXIT_FAILURE);
+    void remover(BufferStore* sb) {
+        loadsDesatualizados = true;
+        storesProntos.erase(sb->status->sequencia);
+        if (sb->enderecoIndexado) {
+            retirar(storesPorEndereco, sb->endereco, sb);
+            sb->enderecoIndexado = false;
+        } else {
+            storesSemEndereco.erase(sb->status->sequencia);
         }
+    }
 
-        string linhaDados;
+    // Algum STORE mais antigo que 'ordem' ainda sem endereço
+    bool haStoreAntigoSemEndereco(long long ordem) const {
+        return !storesSemEndereco.empty() && storesSemEndereco.begin()->first < ordem;
+    }
+};
 
-        while (leitura.peek() != EOF && leitura.peek() == '#')
-            getline(leitura, linhaDados);
+// Instrução na fila de busca, com a previsão feita na busca (BNE)
+struct InstrucaoBuscada {
+    int indice;
+    bool previstoTomado;
+    unsigned historico;   // histórico global antes desta previsão
+};
 
-        for (int i = 0; i < 4; i++) {
-            leitura >> linhaDados;
-            if (linhaDados == "Add_Sub_Reservation_Stations")
-                leitura >> numEstacoesAddSub;
-            else if (linhaDados == "Mul_Div_Reservation_Stations")
-                leitura >> numEstacoesMultDiv;
-            else if (linhaDados == "Load_Buffers")
-                leitura >> numBuffersCarregamento;
-            else if (linhaDados == "Store_Buffers")
-                leitura >> numBuffersArmazenamento;
-        }
+// Entrada do buffer de reordenação (ROB)
+struct EntradaROB {
+    bool ocupado;
+    int indiceInstrucao;
+    int destReg;            // -1 se não escreve registrador
+    bool pronto;            // resultado no CDB (ou STORE executado): pode comitar
+    int valor;
+    int unidade;            // tag da ER/buffer que produz o valor enquanto !pronto
+    EstacaoReserva* er;     // unidade ocupada pela instrução (para descarte)
+    BufferLoad* lb;
+    BufferStore* sb;
+    bool previstoTomado;    // BNE: previsão usada na busca
+    unsigned historico;     // histórico global na busca desta instrução
+    bool leuMemoria;        // LOAD: já leu (endereço e origem do valor abaixo)
+    int enderecoLido;
+    long long ordemFonte;
+    StatusInstrucao* status; // registro desta instância dinâmica (PoolInstancias)
+    EntradaROB()
+        : ocupado(false), indiceInstrucao(-1), destReg(-1), pronto(false), valor(0),
+          unidade(SEM_UNIDADE), er(nullptr), lb(nullptr), sb(nullptr),
+          previstoTomado(false), historico(0), leuMemoria(false), enderecoLido(0),
+          ordemFonte(-1), status(nullptr) {}
+};
 
-        while (leitura.peek() != EOF && leitura.peek() == '#')
-            getline(leitura, linhaDados);
+// Unidades funcionais físicas compartilhadas pelas estações de uma classe.
+// Cada unidade aceita uma nova operação a cada 'intervalo' ciclos (1 =
+// totalmente pipelinada, igual à latência = não pipelinada).
+// quantidade 0 = uma unidade por estação, sem disputa.
+struct GrupoUnidades {
+    string nome;
+    int quantidade = 0;
+    vector<int> livreEm;          // ciclo em que cada unidade aceita nova operação
+    long long operacoes = 0;
+    long long ciclosOcupados = 0; // soma dos intervalos de iniciação
+    long long esperas = 0;        // estações prontas x ciclos sem unidade livre
 
-        for (int i = 0; i < 4; i++) {
-            leitura >> linhaDados;
-            if (linhaDados == "Add_Sub_Cycles")
-                leitura >> ciclosAddSub;
-            else if (linhaDados == "Mul_Cycles")
-                leitura >> ciclosMult;
-            else if (linhaDados == "Load_Store_Cycles")
-                leitura >> ciclosLS;
-            else if (linhaDados == "Div_Cycles")
-                leitura >> ciclosDiv;
-        }
+    void iniciar() { livreEm.assign(quantidade, 0); }
 
-        ciclosAddSub = max(1, ciclosAddSub);
-        ciclosMult   = max(1, ciclosMult);
-        ciclosDiv    = max(1, ciclosDiv);
-        ciclosLS     = max(1, ciclosLS);
+    int unidadeLivre(int ciclo) const {
+        for (int u = 0; u < quantidade; u++)
+            if (livreEm[u] <= ciclo) return u;
+        return -1;
+    }
 
-        buffersCarregamento = new BufferLoad[numBuffersCarregamento];
-        for (int i = 0; i < numBuffersCarregamento; i++)
-            buffersCarregamento[i].nome = TipoBufferLS::CARREGA + to_string(i);
+    int livresEm(int ciclo) const {
+        int n = 0;
+        for (int u = 0; u < quantidade; u++)
+            if (livreEm[u] <= ciclo) n++;
+        return n;
+    }
 
-        buffersArmazenamento = new BufferStore[numBuffersArmazenamento];
-        for (int i = 0; i < numBuffersArmazenamento; i++)
-            buffersArmazenamento[i].nome = TipoBufferLS::ARMAZENA + to_string(i);
+    int proximaLiberacao() const {
+        int m = -1;
+        for (int u = 0; u < quantidade; u++)
+            if (m == -1 || livreEm[u] < m) m = livreEm[u];
+        return m;
+    }
+};
 
-        estacoesAddSub = new EstacaoReserva[numEstacoesAddSub];
-        for (int i = 0; i < numEstacoesAddSub; i++)
-            estacoesAddSub[i].nome = TipoEstacaoReserva::ADIC_SUB + to_string(i);
+enum GrupoFU { FU_ADD_SUB, FU_MUL_DIV, FU_LOAD_STORE, NUM_GRUPOS_FU };
 
-        estacoesMultDiv = new EstacaoReserva[numEstacoesMultDiv];
-        for (int i = 0; i < numEstacoesMultDiv; i++)
-            estacoesMultDiv[i].nome = TipoEstacaoReserva::MULT_DIV + to_string(i);
+// Preditor de dependências de memória no estilo store sets: um LOAD e um STORE
+// que já conflitaram passam a ter o mesmo identificador de conjunto na SSIT
+// (indexada pelo PC). O LOAD só espera os STOREs sem endereço do seu conjunto.
+struct PreditorDependencias {
+    bool ativo = false;
+    int bits = 10;
+    vector<int> ssit; // PC -> conjunto (-1 = nenhum)
+    RegistroEscritas* escritas = nullptr;
 
-        while (leitura.peek() != EOF && leitura.peek() == '#')
-            getline(leitura, linhaDados);
+    void iniciar() { ssit.assign(1u << bits, -1); }
 
-        leitura >> linhaDados; // "Registers"
-        leitura >> numTotalRegistradores;
-        estadoRegistradores = new EstadoRegistrador[numTotalRegistradores];
+    int& conjunto(int pc) { return ssit[pc & ((1 << bits) - 1)]; }
 
-        for (int i = 0; i < numTotalRegistradores; i++) {
-            estadoRegistradores[i].nomeRegistrador = "F" + to_string(i);
-            estadoRegistradores[i].unidadeEscritora.clear();
-            Registrador r;
-            r.nome = "F" + to_string(i);
-            r.valor = 0;
-            registradores.push_back(r);
+    bool dependente(int pcLoad, int pcStore) {
+        int c = conjunto(pcLoad);
+        return c != -1 && c == conjunto(pcStore);
+    }
+
+    // Violação entre o LOAD e o STORE: coloca os dois no mesmo conjunto
+    void unir(int pcLoad, int pcStore) {
+        int& cl = conjunto(pcLoad);
+        int& cs = conjunto(pcStore);
+        if (escritas) {
+            escritas->anotar(&cl, sizeof(int));
+            escritas->anotar(&cs, sizeof(int));
         }
+        if (cl == -1 && cs == -1) cl = cs = pcLoad & ((1 << bits) - 1);
+        else if (cl == -1) cl = cs;
+        else if (cs == -1) cs = cl;
+        else cl = cs = min(cl, cs);
+    }
+};
 
-        while (leitura.peek() != EOF && leitura.peek() == '#')
-            getline(leitura, linhaDados);
+enum PoliticaSubstituicao { SUBST_LRU, SUBST_FIFO, SUBST_ALEATORIA, NUM_POLITICAS_SUBST };
 
-        string token;
-        if (!(leitura >> token)) {
-            cout << "Erro ao ler arquivo apos declaracao de registradores.\n";
-            exit(EXIT_FAILURE);
-        }
+const char* const NOMES_POLITICAS_SUBST[NUM_POLITICAS_SUBST] = { "LRU", "FIFO", "Random" };
 
-        if (!token.empty() && (token[0] == 'F' || token[0] == 'f')) {
-            while (true) {
-                string regName = token;
-                int val;
-                if (!(leitura >> val)) {
-                    cout << "Erro ao ler valor inicial de " << regName << ".\n";
-                    exit(EXIT_FAILURE);
-                }
+// Um nível de cache associativa por conjunto, write-back e write-allocate.
+// Só modela o tempo: os valores continuam em Memoria. Tamanhos em palavras.
+struct Cache {
+    struct Linha {
+        bool valida = false;
+        bool suja = false;
+        uint32_t bloco = 0;     // endereço / tamanhoLinha
+        long long uso = 0;      // último acesso (LRU) ou chegada (FIFO)
+        bool prefetchada = false; // trazida por prefetch e ainda não usada
+    };
 
-                int idx = regIndex(regName);
-                if (idx >= 0 && idx < numTotalRegistradores) {
-                    registradores[idx].valor = val;
-                } else {
-                    cout << "Registrador invalido na inicializacao: " << regName << endl;
-                    exit(EXIT_FAILURE);
-                }
+    string nome;
+    int tamanho = 0;            // 0 = nível ausente
+    int associatividade = 1;
+    int tamanhoLinha = 4;
+    int latencia = 1;           // ciclos de um acerto
+    int politica = SUBST_LRU;
+    int numConjuntos = 0;
+    vector<Linha> linhas;       // conjunto c ocupa [c * associatividade, (c + 1) * associatividade)
+    long long relogio = 0;
+    uint32_t sorteio = 1;       // xorshift da substituição aleatória
+    long long acessos = 0, acertos = 0, writebacks = 0;
+    long long usosPrefetch = 0;        // primeiro acesso a uma linha prefetchada
+    long long prefetchsDespejados = 0; // linhas prefetchadas despejadas sem uso
+    bool acertouPrefetch = false;      // o último acesso foi o primeiro uso de um prefetch
+    RegistroEscritas* escritas = nullptr;
+
+    // Confere a geometria; vazio se válida
+    string validar() const {
+        if (tamanhoLinha < 1 || associatividade < 1 || latencia < 1)
+            return "Line_Size, Associativity e Hit_Cycles devem ser positivos";
+        if (tamanho % (tamanhoLinha * associatividade) != 0)
+            return "Size deve ser multiplo de Line_Size x Associativity";
+        return "";
+    }
 
-                if (!(leitura >> token)) {
-                    cout << "Fim inesperado ao procurar numero de instrucoes.\n";
-                    exit(EXIT_FAILURE);
-                }
+    void iniciar() {
+        numConjuntos = tamanho / (tamanhoLinha * associatividade);
+        linhas.assign((size_t)numConjuntos * associatividade, Linha());
+        relogio = 0;
+        sorteio = 1;
+        acessos = acertos = writebacks = 0;
+        usosPrefetch = prefetchsDespejados = 0;
+    }
 
-                if (!(token[0] == 'F' || token[0] == 'f')) {
-                    try {
-                        numInstrucoes = stoi(token);
-                    } catch (...) {
-                        cout << "Token inesperado onde se esperava numero de instrucoes: " << token << endl;
-                        exit(EXIT_FAILURE);
-                    }
-                    break;
+    // Acessa o bloco; devolve se acertou. Na falha o bloco é alocado e, se a
+    // vítima estava suja, 'despejado' recebe o bloco a escrever no nível abaixo.
+    // 'demanda' falso (writeback do nível acima) não entra nas estatísticas.
+    bool acessar(uint32_t bloco, bool escrita, bool& despejou, uint32_t& despejado,
+                 bool demanda = true) {
+        acessos += demanda;
+        relogio++;
+        despejou = false;
+        acertouPrefetch = false;
+        Linha* conjunto = &linhas[(size_t)(bloco % numConjuntos) * associatividade];
+        for (int v = 0; v < associatividade; v++) {
+            Linha& l = conjunto[v];
+            if (l.valida && l.bloco == bloco) {
+                if (escritas) escritas->anotar(&l, sizeof(Linha));
+                acertos += demanda;
+                if (politica == SUBST_LRU) l.uso = relogio;
+                l.suja |= escrita;
+                if (l.prefetchada && demanda) {
+                    l.prefetchada = false;
+                    usosPrefetch++;
+                    acertouPrefetch = true;
                 }
-            }
-        } else {
-            try {
-                numInstrucoes = stoi(token);
-            } catch (...) {
-                cout << "Token inesperado onde se esperava numero de instrucoes: " << token << endl;
-                exit(EXIT_FAILURE);
+                return true;
             }
         }
+        Linha* vitima = substituir(conjunto, bloco, despejou, despejado);
+        vitima->suja = escrita;
+        return false;
+    }
 
-        instrucoes = new Instrucao[numInstrucoes];
+    // Bloco na cache, sem contar acesso nem mexer na substituição
+    bool presente(uint32_t bloco) const {
+        const Linha* conjunto = &linhas[(size_t)(bloco % numConjuntos) * associatividade];
+        for (int v = 0; v < associatividade; v++)
+            if (conjunto[v].valida && conjunto[v].bloco == bloco) return true;
+        return false;
+    }
 
-        for (int i = 0; i < numInstrucoes; i++) {
-            string tipo; leitura >> tipo;
-            if (tipo == TiposInstrucao::SOMA ||
-                tipo == TiposInstrucao::SUBT ||
-                tipo == TiposInstrucao::MULT ||
-                tipo == TiposInstrucao::DIVI) {
-                instrucoes[i].tipoInstrucao = tipo;
-                leitura >> instrucoes[i].regDestino;
-                leitura >> instrucoes[i].regFonte1;
-                leitura >> instrucoes[i].regFonte2;
-            } else if (tipo == TiposInstrucao::CARREGA) {
-                instrucoes[i].tipoInstrucao = TiposInstrucao::CARREGA;
-                leitura >> instrucoes[i].regFonte2;      // Rt
-                leitura >> instrucoes[i].offsetImediato; // offset
-                leitura >> instrucoes[i].regFonte1;      // Rs
-            } else if (tipo == TiposInstrucao::ARMAZENA) {
-                instrucoes[i].tipoInstrucao = TiposInstrucao::ARMAZENA;
-                leitura >> instrucoes[i].regFonte2;      // Rt (valor)
-                leitura >> instrucoes[i].offsetImediato;
-                leitura >> instrucoes[i].regFonte1;      // Rs (base)
-            } else if (tipo == TiposInstrucao::BNE) {
-                instrucoes[i].tipoInstrucao = TiposInstrucao::BNE;
-                leitura >> instrucoes[i].regFonte1;      // Rs
-                leitura >> instrucoes[i].regFonte2;      // Rt
-                leitura >> instrucoes[i].offsetImediato; // deslocamento
+    // Aloca o bloco trazido por prefetch (que não está na cache), sem contar acesso
+    void instalarPrefetch(uint32_t bloco, bool& despejou, uint32_t& despejado) {
+        relogio++;
+        despejou = false;
+        Linha* conjunto = &linhas[(size_t)(bloco % numConjuntos) * associatividade];
+        Linha* vitima = substituir(conjunto, bloco, despejou, despejado);
+        vitima->suja = false;
+        vitima->prefetchada = true;
+    }
+
+    // Escolhe a vítima do conjunto e a ocupa com o bloco
+    Linha* substituir(Linha* conjunto, uint32_t bloco, bool& despejou, uint32_t& despejado) {
+        Linha* vitima = nullptr;
+        for (int v = 0; v < associatividade && !vitima; v++)
+            if (!conjunto[v].valida) vitima = &conjunto[v];
+        if (!vitima) {
+            if (politica == SUBST_ALEATORIA) {
+                sorteio ^= sorteio << 13;
+                sorteio ^= sorteio >> 17;
+                sorteio ^= sorteio << 5;
+                vitima = &conjunto[sorteio % associatividade];
             } else {
-                // ignora tokens desconhecidos
+                vitima = &conjunto[0];
+                for (int v = 1; v < associatividade; v++)
+                    if (conjunto[v].uso < vitima->uso) vitima = &conjunto[v];
+            }
+            if (vitima->suja) {
+                writebacks++;
+                despejou = true;
+                despejado = vitima->bloco;
             }
+            if (vitima->prefetchada) prefetchsDespejados++;
         }
+        if (escritas) escritas->anotar(vitima, sizeof(Linha));
+        vitima->valida = true;
+        vitima->bloco = bloco;
+        vitima->uso = relogio;
+        vitima->prefetchada = false;
+        return vitima;
     }
+};
 
-    int encontrarBufferLoadLivre() {
-        for (int i = 0; i < numBuffersCarregamento; i++)
-            if (!buffersCarregamento[i].ocupado) return i;
-        return -1;
+enum TipoPrefetcher { PREF_NENHUM, PREF_PROXIMA_LINHA, PREF_PASSO, PREF_STREAM, NUM_TIPOS_PREFETCHER };
+
+const char* const NOMES_PREFETCHERS[NUM_TIPOS_PREFETCHER] = { "None", "NextLine", "Stride", "StreamBuffer" };
+
+// Prefetcher treinado pelos endereços que os LOADs calculam nos buffers.
+// NextLine busca as 'grau' linhas seguintes a uma falha em L1 (ou ao primeiro
+// uso de uma linha prefetchada); Stride guarda, por PC, o último endereço e o
+// passo, e busca 'grau' passos à frente quando o passo se repete. Os dois
+// instalam as linhas em L1. StreamBuffer mantém fora da L1 filas de linhas
+// consecutivas, abertas numa falha e consultadas (pela cabeça) nas seguintes.
+struct Prefetcher {
+    struct EntradaPasso {
+        int pc = -1;
+        int ultimo = 0;
+        int passo = 0;
+        int confianca = 0;  // 0..3; busca a partir de 2
+    };
+    struct BufferStream {
+        deque<pair<uint32_t, int>> linhas; // (bloco de L1, ciclo de chegada)
+        uint32_t proximo = 0;              // próximo bloco a buscar
+        long long uso = 0;                 // 0 = nunca aberto
+    };
+
+    int tipo = PREF_NENHUM;
+    int grau = 1;
+    int bitsTabela = 6;
+    int numStreams = 4;
+    int profundidade = 4;
+    vector<EntradaPasso> tabela;
+    vector<BufferStream> streams;
+    vector<int> alvos;          // endereços sugeridos pelo último acesso
+    long long relogio = 0;
+    long long emitidos = 0;
+    long long usosStream = 0;   // falhas em L1 atendidas por um stream buffer
+    long long atrasados = 0;    // usados antes de os dados chegarem
+    long long descartadosStream = 0; // linhas de stream descartadas sem uso
+    long long semMSHR = 0;      // não emitidos por falta de MSHR
+    RegistroEscritas* escritas = nullptr;
+
+    void iniciar() {
+        tabela.assign(tipo == PREF_PASSO ? 1u << bitsTabela : 0, EntradaPasso());
+        streams.assign(tipo == PREF_STREAM ? numStreams : 0, BufferStream());
+        relogio = 0;
+        emitidos = usosStream = atrasados = descartadosStream = semMSHR = 0;
     }
 
-    int encontrarBufferStoreLivre() {
-        for (int i = 0; i < numBuffersArmazenamento; i++)
-            if (!buffersArmazenamento[i].ocupado) return i;
-        return -1;
+    // Preenche 'alvos' após o acesso do LOAD 'pc' a 'endereco' (NextLine e
+    // Stride). 'gatilho': falha em L1 ou primeiro uso de uma linha prefetchada.
+    void sugerir(int pc, int endereco, int tamanhoLinha, bool gatilho) {
+        alvos.clear();
+        if (tipo == PREF_PROXIMA_LINHA) {
+            if (gatilho)
+                for (int k = 1; k <= grau; k++) alvos.push_back(endereco + k * tamanhoLinha);
+            return;
+        }
+        if (tipo != PREF_PASSO) return;
+        EntradaPasso& e = tabela[pc & ((1 << bitsTabela) - 1)];
+        if (escritas) escritas->anotar(&e, sizeof(EntradaPasso));
+        if (e.pc != pc) {
+            e = EntradaPasso();
+            e.pc = pc;
+            e.ultimo = endereco;
+            return;
+        }
+        int passo = endereco - e.ultimo;
+        e.ultimo = endereco;
+        if (passo == e.passo) e.confianca = min(3, e.confianca + 1);
+        else if (e.confianca > 0) e.confianca--;
+        else e.passo = passo;
+        if (e.confianca < 2 || e.passo == 0) return;
+        for (int k = 1; k <= grau; k++) alvos.push_back(endereco + k * e.passo);
     }
+};
 
-    int encontrarERAddSubLivre() {
-        for (int i = 0; i < numEstacoesAddSub; i++)
-            if (!estacoesAddSub[i].ocupado) return i;
-        return -1;
+// L1 e L2 (opcional) à frente da memória principal. Sem L1 todo acesso custa
+// Load_Store_Cycles, como antes; com L1 a latência é a soma das latências dos
+// níveis consultados até o acerto (ou até a memória, Memory_Cycles).
+// O lado da memória também limita a banda: no máximo numPortas acessos
+// começam por ciclo, uma falha em L1 ocupa um MSHR até os dados chegarem
+// (falhas na mesma linha se juntam ao MSHR já aberto) e a memória principal é
+// dividida em numBancos bancos, cada um ocupado por ocupacaoBanco ciclos a
+// cada acesso. Cada acesso reserva esses recursos no ciclo em que começa e
+// recebe a latência total, com as esperas incluídas. Prefetches (ver
+// Prefetcher) também ocupam MSHRs e bancos, mas não portas.
+struct HierarquiaMemoria {
+    struct MSHR {
+        uint32_t bloco;   // bloco de L1 em falha
+        int fim;          // ciclo em que os dados chegam
+        bool stream;      // linha indo para um stream buffer (não se junta a falhas)
+    };
+
+    Cache niveis[2];
+    int latenciaMemoria = 50;
+    int latenciaSemCache = 1;       // Load_Store_Cycles, sem L1
+    int numPortas = 0;              // 0 = sem limite
+    int numMSHRs = 0;               // 0 = sem limite
+    int numBancos = 0;              // 0 = memória sem bancos
+    int ocupacaoBanco = 4;
+    map<int, int> usoPortas;        // ciclo -> acessos iniciados
+    vector<MSHR> mshrs;
+    vector<int> bancoLivre;         // banco -> primeiro ciclo livre
+    long long acessosMemoria = 0;   // falhas no último nível
+    long long escritasMemoria = 0;  // writebacks do último nível
+    long long esperasPorta = 0, ciclosEsperaPorta = 0;
+    long long fusoesMSHR = 0, esperasMSHR = 0, ciclosEsperaMSHR = 0;
+    long long conflitosBanco = 0, ciclosConflitoBanco = 0;
+    int picoMSHRs = 0;
+    long long falhasDemanda = 0;    // falhas em L1 levadas ao nível abaixo
+    Prefetcher prefetcher;
+
+    bool ativa() const { return niveis[0].tamanho > 0; }
+    bool modelada() const { return ativa() || numPortas > 0 || numBancos > 0; }
+
+    void iniciar() {
+        niveis[0].nome = "L1";
+        niveis[1].nome = "L2";
+        for (Cache& c : niveis)
+            if (c.tamanho > 0) c.iniciar();
+        usoPortas.clear();
+        mshrs.clear();
+        bancoLivre.assign(numBancos, 0);
+        acessosMemoria = escritasMemoria = 0;
+        esperasPorta = ciclosEsperaPorta = 0;
+        fusoesMSHR = esperasMSHR = ciclosEsperaMSHR = 0;
+        conflitosBanco = ciclosConflitoBanco = 0;
+        picoMSHRs = 0;
+        falhasDemanda = 0;
+        prefetcher.iniciar();
+    }
+
+    // Prefetches usados e descartados sem uso (em L1 e nos stream buffers)
+    long long prefetchsUteis() const { return niveis[0].usosPrefetch + prefetcher.usosStream; }
+    long long prefetchsInuteis() const { return niveis[0].prefetchsDespejados + prefetcher.descartadosStream; }
+
+    // Acesso que começa no ciclo 'ciclo': devolve a latência total e, em
+    // 'espera', quantos desses ciclos foram de fila (porta, MSHR e banco).
+    // 'pc' >= 0 (LOAD) treina o prefetcher.
+    int acessar(int endereco, bool escrita, int ciclo, int& espera, int pc = -1) {
+        espera = 0;
+        int t = reservarPorta(ciclo, espera);
+        if (!ativa()) return acessarMemoria((uint32_t)endereco, t, latenciaSemCache, espera) - ciclo;
+
+        Cache& l1 = niveis[0];
+        t += l1.latencia;
+        bool falhou;
+        int pronto = acessarL1(endereco, escrita, t, ciclo, espera, falhou);
+        if (pc >= 0 && prefetcher.tipo != PREF_NENHUM) {
+            prefetcher.sugerir(pc, endereco, l1.tamanhoLinha, falhou || l1.acertouPrefetch);
+            for (int alvo : prefetcher.alvos) prefetchar(alvo, t, ciclo);
+        }
+        return pronto - ciclo;
+    }
+
+    // Consulta de L1 terminada em 't': devolve o ciclo em que os dados ficam prontos
+    int acessarL1(int endereco, bool escrita, int t, int agora, int& espera, bool& falhou) {
+        Cache& l1 = niveis[0];
+        uint32_t blocoL1 = (uint32_t)endereco / l1.tamanhoLinha;
+        bool despejou;
+        uint32_t despejado;
+        falhou = false;
+        for (const MSHR& m : mshrs) {
+            if (m.bloco != blocoL1 || m.fim <= t || m.stream) continue;
+            // Linha já a caminho: falha secundária, espera o mesmo preenchimento
+            fusoesMSHR++;
+            if (l1.acessar(blocoL1, escrita, despejou, despejado)) {
+                l1.acertos--;
+                if (l1.acertouPrefetch) prefetcher.atrasados++;
+            }
+            if (despejou) escreverAbaixo(0, despejado * l1.tamanhoLinha);
+            return max(t, m.fim);
+        }
+        bool acertou = l1.acessar(blocoL1, escrita, despejou, despejado);
+        if (despejou) escreverAbaixo(0, despejado * l1.tamanhoLinha);
+        if (acertou) return t;
+
+        falhou = true;
+        int pronto;
+        if (prefetcher.tipo == PREF_STREAM && consultarStreams(blocoL1, t, agora, pronto)) return pronto;
+        int inicioFalha = reservarMSHR(t, agora, espera);
+        falhasDemanda++;
+        pronto = buscarAbaixo((uint32_t)endereco, inicioFalha, espera, true);
+        mshrs.push_back({ blocoL1, pronto, false });
+        int abertos = 0;
+        for (const MSHR& m : mshrs) abertos += m.fim > inicioFalha;
+        picoMSHRs = max(picoMSHRs, abertos);
+        if (prefetcher.tipo == PREF_STREAM) alocarStream(blocoL1, inicioFalha, agora);
+        return pronto;
+    }
+
+    // Falha de L1 saindo em 't': L2 (se houver) e memória principal
+    int buscarAbaixo(uint32_t endereco, int t, int& espera, bool demanda) {
+        Cache& l2 = niveis[1];
+        bool acertou = false;
+        if (l2.tamanho > 0) {
+            t += l2.latencia;
+            bool despejou;
+            uint32_t despejado;
+            acertou = l2.acessar(endereco / l2.tamanhoLinha, false, despejou, despejado, demanda);
+            if (despejou) escreverAbaixo(1, despejado * l2.tamanhoLinha);
+        }
+        return acertou ? t : acessarMemoria(endereco, t, latenciaMemoria, espera);
+    }
+
+    // Prefetch para L1 emitido em 't', se a linha não está nem vem a caminho
+    // e há MSHR livre
+    void prefetchar(int endereco, int t, int agora) {
+        Cache& l1 = niveis[0];
+        uint32_t bloco = (uint32_t)endereco / l1.tamanhoLinha;
+        if (l1.presente(bloco)) return;
+        descartarMSHRsFechados(agora);
+        if (!mshrLivre(t)) {
+            prefetcher.semMSHR++;
+            return;
+        }
+        int espera = 0;
+        int pronto = buscarAbaixo((uint32_t)endereco, t, espera, false);
+        bool despejou;
+        uint32_t despejado;
+        l1.instalarPrefetch(bloco, despejou, despejado);
+        if (despejou) escreverAbaixo(0, despejado * l1.tamanhoLinha);
+        mshrs.push_back({ bloco, pronto, false });
+        prefetcher.emitidos++;
+    }
+
+    bool mshrLivre(int t) const {
+        if (numMSHRs == 0) return true;
+        int abertos = 0;
+        for (const MSHR& m : mshrs) abertos += m.fim > t;
+        return abertos < numMSHRs;
+    }
+
+    // Falha em L1 que acerta a cabeça de um stream buffer: a linha passa para a
+    // L1 e o buffer busca mais uma no fim
+    bool consultarStreams(uint32_t bloco, int t, int agora, int& pronto) {
+        for (Prefetcher::BufferStream& sb : prefetcher.streams) {
+            if (sb.linhas.empty() || sb.linhas.front().first != bloco) continue;
+            pronto = max(t, sb.linhas.front().second);
+            prefetcher.usosStream++;
+            if (pronto > t) prefetcher.atrasados++;
+            sb.linhas.pop_front();
+            sb.uso = ++prefetcher.relogio;
+            completarStream(sb, t, agora);
+            return true;
+        }
+        return false;
+    }
+
+    // Reabre o stream buffer menos usado a partir do bloco seguinte ao da falha
+    void alocarStream(uint32_t bloco, int t, int agora) {
+        Prefetcher::BufferStream* sb = &prefetcher.streams[0];
+        for (Prefetcher::BufferStream& s : prefetcher.streams)
+            if (s.uso < sb->uso) sb = &s;
+        prefetcher.descartadosStream += sb->linhas.size();
+        sb->linhas.clear();
+        sb->proximo = bloco + 1;
+        sb->uso = ++prefetcher.relogio;
+        completarStream(*sb, t, agora);
+    }
+
+    // Busca linhas para o buffer até 'profundidade', cada uma num MSHR como os
+    // demais prefetches; sem MSHR livre a vaga fica vazia até o próximo uso do
+    // buffer (ou até ele ser reaberto)
+    void completarStream(Prefetcher::BufferStream& sb, int t, int agora) {
+        descartarMSHRsFechados(agora);
+        while ((int)sb.linhas.size() < prefetcher.profundidade) {
+            if (!mshrLivre(t)) {
+                prefetcher.semMSHR++;
+                return;
+            }
+            int espera = 0;
+            int pronto = buscarAbaixo(sb.proximo * niveis[0].tamanhoLinha, t, espera, false);
+            sb.linhas.push_back({ sb.proximo, pronto });
+            mshrs.push_back({ sb.proximo, pronto, true });
+            sb.proximo++;
+            prefetcher.emitidos++;
+        }
+    }
+
+    // Primeiro ciclo a partir de 'ciclo' com porta livre, já reservada
+    int reservarPorta(int ciclo, int& espera) {
+        if (numPortas == 0) return ciclo;
+        while (!usoPortas.empty() && usoPortas.begin()->first < ciclo) usoPortas.erase(usoPortas.begin());
+        int c = ciclo;
+        while (usoPortas[c] >= numPortas) c++;
+        usoPortas[c]++;
+        if (c > ciclo) {
+            esperasPorta++;
+            ciclosEsperaPorta += c - ciclo;
+            espera += c - ciclo;
+        }
+        return c;
+    }
+
+    // Ciclo em que a falha detectada em 't' obtém um MSHR (com numMSHRs
+    // abertos, espera o primeiro a fechar). Descarta os fechados até 'agora'.
+    int reservarMSHR(int t, int agora, int& espera) {
+        descartarMSHRsFechados(agora);
+        if (numMSHRs == 0) return t;
+        int q = t;
+        while (true) {
+            int abertos = 0, proximo = -1;
+            for (const MSHR& m : mshrs) {
+                if (m.fim <= q) continue;
+                abertos++;
+                if (proximo == -1 || m.fim < proximo) proximo = m.fim;
+            }
+            if (abertos < numMSHRs) break;
+            q = proximo;
+        }
+        if (q > t) {
+            esperasMSHR++;
+            ciclosEsperaMSHR += q - t;
+            espera += q - t;
+        }
+        return q;
+    }
+
+    void descartarMSHRsFechados(int agora) {
+        size_t n = 0;
+        for (const MSHR& m : mshrs)
+            if (m.fim > agora) mshrs[n++] = m;
+        mshrs.resize(n);
+    }
+
+    // Acesso à memória principal chegando em 'chegada': devolve o ciclo em que
+    // os dados ficam prontos, após esperar o banco da linha ficar livre
+    int acessarMemoria(uint32_t endereco, int chegada, int latencia, int& espera) {
+        acessosMemoria++;
+        if (numBancos == 0) return chegada + latencia;
+        const Cache& ultimo = niveis[1].tamanho > 0 ? niveis[1] : niveis[0];
+        uint32_t linha = ativa() ? endereco / ultimo.tamanhoLinha : endereco;
+        int& livre = bancoLivre[linha % numBancos];
+        int inicio = max(chegada, livre);
+        if (inicio > chegada) {
+            conflitosBanco++;
+            ciclosConflitoBanco += inicio - chegada;
+            espera += inicio - chegada;
+        }
+        livre = inicio + ocupacaoBanco;
+        return inicio + latencia;
+    }
+
+    // Acesso só às etiquetas, sem tempo nem estatísticas: aquece as caches
+    // durante a emulação funcional da amostragem
+    void aquecer(int endereco, bool escrita) {
+        Cache& l1 = niveis[0];
+        Cache& l2 = niveis[1];
+        long long writebacks[2] = { l1.writebacks, l2.writebacks };
+        long long despejados = l1.prefetchsDespejados;
+        bool despejou;
+        uint32_t despejado;
+        bool acertou = l1.acessar((uint32_t)endereco / l1.tamanhoLinha, escrita, despejou, despejado, false);
+        if (l2.tamanho > 0) {
+            bool despejouL2;
+            uint32_t despejadoL2;
+            if (despejou)
+                l2.acessar(despejado * l1.tamanhoLinha / l2.tamanhoLinha, true, despejouL2, despejadoL2, false);
+            if (!acertou)
+                l2.acessar((uint32_t)endereco / l2.tamanhoLinha, false, despejouL2, despejadoL2, false);
+        }
+        l1.writebacks = writebacks[0];
+        l2.writebacks = writebacks[1];
+        l1.prefetchsDespejados = despejados;
+    }
+
+    // Writeback de uma linha suja do nível n: fora do caminho crítico (buffer de escrita)
+    void escreverAbaixo(int n, uint32_t endereco) {
+        if (n == 1 || niveis[1].tamanho == 0) {
+            escritasMemoria++;
+            return;
+        }
+        Cache& l2 = niveis[1];
+        bool despejou;
+        uint32_t despejado;
+        l2.acessar(endereco / l2.tamanhoLinha, true, despejou, despejado, false);
+        if (despejou) escritasMemoria++;
+    }
+};
+
+enum TipoPreditor { PRED_NAO_TOMADO, PRED_BIMODAL, PRED_GSHARE };
+
+const char* const NOMES_PREDITORES[] = { "NotTaken", "Bimodal", "GShare" };
+
+// Preditor de desvios: contadores saturados de 2 bits indexados pelo PC
+// (bimodal) ou pelo PC xor histórico global (gshare). O histórico é
+// atualizado na busca com a previsão e restaurado quando ela erra.
+struct PreditorDesvio {
+    int tipo = PRED_NAO_TOMADO;
+    int bitsTabela = 10;
+    vector<uint8_t> contadores;
+    unsigned historico = 0;
+    RegistroEscritas* escritas = nullptr;
+
+    void iniciar() {
+        contadores.assign(1u << bitsTabela, 1); // fracamente não tomado
+        historico = 0;
+    }
+
+    unsigned mascara() const { return (1u << bitsTabela) - 1; }
+
+    unsigned indice(int pc, unsigned hist) const {
+        return (tipo == PRED_GSHARE ? ((unsigned)pc ^ hist) : (unsigned)pc) & mascara();
+    }
+
+    bool prever(int pc) const {
+        if (tipo == PRED_NAO_TOMADO) return false;
+        return contadores[indice(pc, historico)] >= 2;
+    }
+
+    void especular(bool tomado) { historico = ((historico << 1) | (tomado ? 1u : 0u)) & mascara(); }
+
+    void atualizar(int pc, unsigned hist, bool tomado) {
+        if (tipo == PRED_NAO_TOMADO) return;
+        uint8_t& c = contadores[indice(pc, hist)];
+        if (escritas) escritas->anotar(&c, sizeof(c));
+        if (tomado) { if (c < 3) c++; }
+        else if (c > 0) c--;
+    }
+
+    void restaurar(unsigned hist, bool tomado) {
+        historico = hist;
+        especular(tomado);
+    }
+};
+
+// Políticas de arbitragem dos CDBs (CDB_Policy)
+enum PoliticaCDB {
+    CDB_ROUND_ROBIN,     // rodízio entre classes ADD/SUB, MUL/DIV e LOAD
+    CDB_MAIS_ANTIGA,     // instrução emitida primeiro
+    CDB_MAIOR_LATENCIA,  // maior latência de execução primeiro
+    CDB_PRIORIDADE_FIXA  // ADD/SUB/BNE > MUL/DIV > LOAD
+};
+
+const char* const NOMES_POLITICAS_CDB[] = { "RoundRobin", "Oldest", "LongestLatency", "FixedPriority" };
+
+// Motivo de um slot de emissão não usado em um ciclo
+enum MotivoSlotVazio {
+    SLOT_FILA_VAZIA,      // nada buscado (fim do programa)
+    SLOT_BRANCH,          // BNE pendente bloqueando busca/emissão
+    SLOT_SEM_ER_ADD_SUB,  // hazard estrutural na cabeça da fila
+    SLOT_SEM_ER_MUL_DIV,
+    SLOT_SEM_BUFFER_LOAD,
+    SLOT_SEM_BUFFER_STORE,
+    SLOT_SEM_ROB,         // ROB cheio
+    NUM_MOTIVOS_SLOT
+};
+
+const char* const NOMES_MOTIVOS_SLOT[NUM_MOTIVOS_SLOT] = {
+    "fila vazia", "branch pendente", "sem ER ADD/SUB",
+    "sem ER MUL/DIV", "sem Buffer LOAD", "sem Buffer STORE", "ROB cheio"
+};
+
+// Para onde foi cada ciclo (pilha de CPI): o ciclo em que alguma instrução
+// conclui conta como base; nos demais, vale o estado da instrução mais antiga
+// em voo que não está executando (execução só se todas estão). Por unidade, as
+// mesmas categorias contam o estado de cada ocupante.
+enum CategoriaCiclo {
+    CICLO_BASE,           // alguma instrução concluiu (commit, com ROB)
+    CICLO_EXECUCAO,       // recém-emitida ou executando
+    CICLO_DEPENDENCIA,    // esperando operando (RAW)
+    CICLO_UNIDADE,        // pronta, sem unidade funcional livre
+    CICLO_CDB,            // execução terminada, esperando barramento
+    CICLO_MEMORIA,        // LOAD/STORE esperando um acesso anterior (só por unidade:
+                          // na pilha, quem segura o LOAD é um STORE mais antigo)
+    CICLO_BANDA,          // acesso na fila de porta, MSHR ou banco de memória
+    CICLO_COMMIT,         // pronta, esperando a cabeça do ROB
+    CICLO_DESVIO,         // nada em voo, busca parada por desvio
+    CICLO_FRONT_END,      // nada em voo nem para buscar
+    NUM_CATEGORIAS_CICLO
+};
+
+const char* const NOMES_CATEGORIAS_CICLO[NUM_CATEGORIAS_CICLO] = {
+    "base", "execucao", "dependencia RAW", "unidade funcional", "disputa de CDB",
+    "ordem de memoria", "banda de memoria", "espera de commit", "desvio", "front end"
+};
+
+// Classes de instrução das colunas da pilha de CPI
+enum ClasseInstrucao {
+    CLASSE_ADD_SUB, CLASSE_MUL, CLASSE_DIV, CLASSE_LOAD, CLASSE_STORE,
+    CLASSE_DESVIO, CLASSE_NOP, NUM_CLASSES_INSTRUCAO
+};
+
+const char* const NOMES_CLASSES_INSTRUCAO[NUM_CLASSES_INSTRUCAO] = {
+    "ADD/SUB", "MUL", "DIV", "LOAD", "STORE", "DESVIO", "NOP"
+};
+
+inline int classeInstrucao(uint8_t tipo) {
+    switch (operacaoBase(tipo)) {
+    case TiposInstrucao::SOMA:
+    case TiposInstrucao::SUBT:     return CLASSE_ADD_SUB;
+    case TiposInstrucao::MULT:     return CLASSE_MUL;
+    case TiposInstrucao::DIVI:     return CLASSE_DIV;
+    case TiposInstrucao::CARREGA:  return CLASSE_LOAD;
+    case TiposInstrucao::ARMAZENA: return CLASSE_STORE;
+    case TiposInstrucao::NOP:      return CLASSE_NOP;
+    default:                       return CLASSE_DESVIO;
+    }
+}
+
+// Converte o texto inteiro em número; falso se sobrar algum caractere
+bool converterInteiro(const string& texto, int& valor) {
+    try {
+        size_t usados;
+        valor = stoi(texto, &usados);
+        return usados == texto.size();
+    } catch (...) {
+        return false;
+    }
+}
+
+// Arquivo de entrada lido token a token, guardando a linha de cada um para as
+// mensagens de erro. '#' e ';' iniciam comentário até o fim da linha; vírgulas
+// e parênteses separam tokens, então "LOAD F1, 8(F2)" equivale a "LOAD F1 8 F2".
+struct LeitorFonte {
+    string nomeArquivo;
+    ifstream arquivo;
+    istringstream emMemoria;
+    istream* entrada = &arquivo;
+    vector<string> tokens; // tokens da linha atual
+    size_t pos = 0;
+    int linha = 0;
+
+    bool abrir(const string& nome) {
+        nomeArquivo = nome;
+        arquivo.open(nome);
+        return arquivo.is_open();
+    }
+
+    // Texto já em memória (cargas do --bench); 'nome' só aparece nos erros
+    void abrirTexto(const string& nome, const string& texto) {
+        nomeArquivo = nome;
+        emMemoria.str(texto);
+        entrada = &emMemoria;
+    }
+
+    // Garante um token disponível, passando às linhas seguintes; falso no fim
+    bool haToken() {
+        while (pos == tokens.size()) {
+            string texto;
+            if (!getline(*entrada, texto)) return false;
+            linha++;
+            tokens.clear();
+            pos = 0;
+            size_t c = texto.find_first_of("#;");
+            if (c != string::npos) texto.erase(c);
+            for (char& ch : texto)
+                if (ch == ',' || ch == '(' || ch == ')') ch = ' ';
+            istringstream ss(texto);
+            string t;
+            while (ss >> t) tokens.push_back(t);
+        }
+        return true;
+    }
+
+    bool fimDaLinha() const { return pos == tokens.size(); }
+
+    const string& espiar() {
+        if (!haToken()) erro("fim inesperado do arquivo");
+        return tokens[pos];
+    }
+
+    string ler(const string& esperado) {
+        if (!haToken()) erro("fim inesperado do arquivo; esperava " + esperado);
+        return tokens[pos++];
+    }
+
+    // Próximo token da mesma linha (operandos de uma instrução ou de um parâmetro)
+    string lerNaLinha(const string& esperado) {
+        if (fimDaLinha()) erro(esperado + " ausente");
+        return tokens[pos++];
+    }
+
+    int lerInteiro(const string& esperado, bool naLinha = false) {
+        string t = naLinha ? lerNaLinha(esperado) : ler(esperado);
+        int valor;
+        if (!converterInteiro(t, valor)) erro(esperado + " invalido: " + t);
+        return valor;
+    }
+
+    [[noreturn]] void erro(const string& msg) const { erro(linha, msg); }
+
+    // Linha 0: erro fora do arquivo (ajuste "Chave=valor" da linha de comando)
+    [[noreturn]] void erro(int numLinha, const string& msg) const {
+        cout << nomeArquivo << (numLinha > 0 ? ":" + to_string(numLinha) : string()) << ": " << msg << endl;
+        exit(EXIT_FAILURE);
+    }
+};
+
+// Checkpoint binário do estado do simulador: assinatura e versão seguidas dos
+// campos na ordem de Tomasulo::transferirEstado, na ordem de bytes do host.
+// Gravação e leitura fazem o mesmo percurso ('gravando' escolhe o sentido),
+// então os dois lados não divergem. Ponteiros viram índices nos vetores.
+const char ASSINATURA_CHECKPOINT[8] = "TOMCKPT";
+const uint32_t VERSAO_CHECKPOINT = 4;
+
+struct Checkpoint {
+    bool gravando = true;
+    string dados;
+    size_t pos = 0;
+    string erro;      // primeira falha na leitura
+    bool soNucleo = false;  // depurador: sem memória, registradores e tabelas (ver RegistroEscritas)
+    vector<size_t> secoes;  // na gravação, início de cada seção (unidade, registrador...)
+
+    void secao() {
+        if (gravando) secoes.push_back(dados.size());
+    }
+
+    void bytes(void* p, size_t n) {
+        if (gravando) {
+            dados.append((const char*)p, n);
+            return;
+        }
+        if (!erro.empty() || dados.size() - pos < n) {
+            if (erro.empty()) erro = "arquivo truncado";
+            memset(p, 0, n);
+            return;
+        }
+        memcpy(p, dados.data() + pos, n);
+        pos += n;
+    }
+
+    template <typename T>
+    void campo(T& v) {
+        static_assert(is_trivially_copyable<T>::value, "campo de checkpoint deve ser POD");
+        bytes(&v, sizeof(T));
+    }
+
+    // Quantidade de elementos: grava 'n'; na leitura devolve a lida
+    size_t tamanho(size_t n) {
+        uint64_t k = n;
+        campo(k);
+        if (!gravando && k > dados.size() - pos) {
+            if (erro.empty()) erro = "arquivo truncado";
+            return 0;
+        }
+        return (size_t)k;
+    }
+
+    // Valor da configuração: gravado, e na leitura conferido com o atual
+    void conferir(long long valor, const char* nome) {
+        long long lido = valor;
+        campo(lido);
+        if (!gravando && erro.empty() && lido != valor)
+            erro = string(nome) + " difere da configuracao atual (" + to_string(lido) + " no checkpoint)";
+    }
+
+    void texto(string& s) {
+        size_t n = tamanho(s.size());
+        if (!gravando) s.resize(n);
+        if (n) bytes(&s[0], n);
+    }
+
+    // deque de elementos POD
+    template <typename C>
+    void lista(C& c) {
+        size_t n = tamanho(c.size());
+        if (!gravando) c.resize(n);
+        for (auto& x : c) campo(x);
+    }
+
+    // vector de elementos POD: os mesmos bytes, num bloco só
+    template <typename T>
+    void lista(vector<T>& c) {
+        static_assert(is_trivially_copyable<T>::value, "campo de checkpoint deve ser POD");
+        size_t n = tamanho(c.size());
+        if (!gravando) c.resize(n);
+        if (n) bytes(c.data(), n * sizeof(T));
+    }
+
+    template <typename T>
+    void ordenado(set<T>& c) {
+        size_t n = tamanho(c.size());
+        if (gravando) {
+            for (T x : c) campo(x);
+            return;
+        }
+        c.clear();
+        for (size_t i = 0; i < n; i++) {
+            T x;
+            campo(x);
+            c.insert(x);
+        }
+    }
+
+    template <typename K, typename V>
+    void ordenado(map<K, V>& c) {
+        size_t n = tamanho(c.size());
+        if (gravando) {
+            for (auto& e : c) {
+                K k = e.first;
+                campo(k);
+                campo(e.second);
+            }
+            return;
+        }
+        c.clear();
+        for (size_t i = 0; i < n; i++) {
+            K k;
+            campo(k);
+            campo(c[k]);
+        }
+    }
+
+    // Ponteiro para um elemento de [base, base + n), gravado como índice (-1 = nulo)
+    template <typename T>
+    void indice(T*& p, T* base, int n) {
+        int i = p ? (int)(p - base) : -1;
+        campo(i);
+        if (gravando) return;
+        if (i < -1 || i >= n) {
+            if (erro.empty()) erro = "indice fora da faixa";
+            i = -1;
+        }
+        p = i == -1 ? nullptr : base + i;
+    }
+
+    template <typename C, typename T>
+    void indices(C& c, T* base, int n) {
+        size_t k = tamanho(c.size());
+        if (!gravando) c.resize(k);
+        for (auto& p : c) indice(p, base, n);
+    }
+
+    // Ponteiros por ordem de emissão (map ordenado)
+    template <typename T>
+    void indicesPorOrdem(map<long long, T*>& c, T* base, int n) {
+        size_t k = tamanho(c.size());
+        if (gravando) {
+            for (auto& e : c) {
+                long long ordem = e.first;
+                campo(ordem);
+                indice(e.second, base, n);
+            }
+            return;
+        }
+        c.clear();
+        for (size_t i = 0; i < k && erro.empty(); i++) {
+            long long ordem;
+            campo(ordem);
+            indice(c[ordem], base, n);
+        }
+    }
+
+    template <typename T>
+    void indicesPorEndereco(unordered_map<int, vector<T*>>& c, T* base, int n) {
+        size_t k = tamanho(c.size());
+        if (gravando) {
+            for (auto& e : c) {
+                int endereco = e.first;
+                campo(endereco);
+                indices(e.second, base, n);
+            }
+            return;
+        }
+        c.clear();
+        for (size_t i = 0; i < k && erro.empty(); i++) {
+            int endereco;
+            campo(endereco);
+            indices(c[endereco], base, n);
+        }
+    }
+};
+
+// Estados passados do depurador, para voltar ciclos sem resimular. Cada ciclo
+// guarda o núcleo do estado (Checkpoint com soNucleo: unidades, ROB, filas e
+// contadores), dividido em seções, só com os trechos das seções que mudaram
+// desde o ciclo anterior (tudo a cada INTERVALO ciclos), e o registro de
+// desfazer das escritas do ciclo na memória, registradores e tabelas. Voltar
+// a um ciclo monta o núcleo a partir da última foto e desfaz as escritas dos
+// ciclos seguintes. Passando de LIMITE_BYTES, os intervalos mais antigos saem.
+struct HistoricoEstados {
+    static const int INTERVALO = 256;
+    static const size_t LIMITE_BYTES = 64u << 20;
+
+    int primeiro = -1;      // ciclo do primeiro estado guardado
+    deque<string> nucleos;  // nucleos[c - primeiro]: (seção, tamanho, trechos) das seções mudadas
+    deque<string> escritas; // escritas[c - primeiro]: registro de desfazer do ciclo c
+    vector<string> atual;   // seções do último ciclo guardado
+    size_t bytes = 0;       // memória ocupada pelos núcleos e registros
+
+    int ultimo() const { return primeiro + (int)nucleos.size() - 1; }
+    bool contem(int ciclo) const { return primeiro != -1 && ciclo >= primeiro && ciclo <= ultimo(); }
+
+    // Núcleo no início de 'ciclo', com as seções começando em 'secoes'. A
+    // simulação é determinística, então um ciclo já guardado não muda; fora de
+    // sequência o histórico recomeça.
+    void guardar(int ciclo, const string& nucleo, const vector<size_t>& secoes) {
+        if (contem(ciclo)) return;
+        if (primeiro == -1 || ciclo != ultimo() + 1) {
+            primeiro = ciclo;
+            nucleos.clear();
+            escritas.clear();
+            bytes = 0;
+        }
+        bool foto = (ciclo - primeiro) % INTERVALO == 0;
+        atual.resize(secoes.size());
+        string d;
+        for (size_t k = 0; k < secoes.size(); k++) {
+            const char* novo = nucleo.data() + secoes[k];
+            size_t n = (k + 1 < secoes.size() ? secoes[k + 1] : nucleo.size()) - secoes[k];
+            string& antes = atual[k];
+            if (!foto && antes.size() == n && memcmp(antes.data(), novo, n) == 0) continue;
+            escreverNumero(d, k);
+            escreverNumero(d, n);
+            if (foto || antes.size() != n) {
+                if (n > 0) trecho(d, 0, n, novo);
+            } else {
+                // Só os trechos que mudaram; menos de 4 bytes iguais não separam trechos
+                for (size_t i = 0; i < n;) {
+                    size_t j = i;
+                    for (uint64_t a, b; j + 8 <= n; j += 8) {
+                        memcpy(&a, antes.data() + j, 8);
+                        memcpy(&b, novo + j, 8);
+                        if (a != b) break;
+                    }
+                    while (j < n && antes[j] == novo[j]) j++;
+                    size_t e = j, iguais = 0;
+                    while (e < n && iguais < 4) {
+                        iguais = antes[e] == novo[e] ? iguais + 1 : 0;
+                        e++;
+                    }
+                    e -= iguais;
+                    trecho(d, j - i, e - j, novo + j);
+                    i = e;
+                }
+            }
+            antes.assign(novo, n);
+        }
+        d.shrink_to_fit();
+        bytes += d.size() + 2 * sizeof(string);
+        nucleos.push_back(move(d));
+        escritas.emplace_back();
+    }
+
+    // Trecho de uma seção: 'salto' bytes mantidos e 'n' bytes novos
+    static void trecho(string& d, size_t salto, size_t n, const char* novos) {
+        escreverNumero(d, salto);
+        escreverNumero(d, n);
+        d.append(novos, n);
+    }
+
+    // Registro de desfazer do último ciclo guardado, anotado na simulação dele
+    void concluir(string registro) {
+        registro.shrink_to_fit();
+        bytes += registro.size();
+        escritas.back() = move(registro);
+        while (bytes > LIMITE_BYTES && nucleos.size() > (size_t)INTERVALO) {
+            for (int k = 0; k < INTERVALO; k++) {
+                bytes -= nucleos.front().size() + escritas.front().size() + 2 * sizeof(string);
+                nucleos.pop_front();
+                escritas.pop_front();
+            }
+            primeiro += INTERVALO;
+        }
+    }
+
+    // Núcleo no início de 'ciclo': a foto do intervalo e as seções mudadas até ele
+    string reconstruir(int ciclo) const {
+        vector<string> secoes;
+        for (int c = primeiro + (ciclo - primeiro) / INTERVALO * INTERVALO; c <= ciclo; c++) {
+            const string& d = nucleos[c - primeiro];
+            for (size_t pos = 0; pos < d.size();) {
+                size_t k = lerNumero(d, pos);
+                size_t n = lerNumero(d, pos);
+                if (k >= secoes.size()) secoes.resize(k + 1);
+                string& s = secoes[k];
+                s.resize(n);
+                for (size_t i = 0; i < n;) {
+                    i += lerNumero(d, pos);
+                    size_t m = lerNumero(d, pos);
+                    memcpy(&s[i], d.data() + pos, m);
+                    i += m;
+                    pos += m;
+                }
+            }
+        }
+        string nucleo;
+        for (const string& s : secoes) nucleo += s;
+        return nucleo;
+    }
+
+    // Desfaz as escritas dos ciclos 'ciclo' a 'ate' - 1, do último ao primeiro
+    void desfazer(int ciclo, int ate) const {
+        for (int c = ate - 1; c >= ciclo; c--) RegistroEscritas::desfazer(escritas[c - primeiro]);
+    }
+
+    static void escreverNumero(string& s, size_t v) {
+        while (v >= 0x80) {
+            s += (char)((v & 0x7F) | 0x80);
+            v >>= 7;
+        }
+        s += (char)v;
+    }
+
+    static size_t lerNumero(const string& s, size_t& pos) {
+        size_t v = 0;
+        for (int desloc = 0;; desloc += 7) {
+            unsigned char b = s[pos++];
+            v |= (size_t)(b & 0x7F) << desloc;
+            if (!(b & 0x80)) return v;
+        }
+    }
+};
+
+enum TipoBreakpoint { BP_EMISSAO, BP_CONCLUSAO, BP_ESCRITA, BP_REGISTRADOR, BP_MEMORIA };
+
+// Condição de parada do depurador: instrução (índice) que emite, termina a
+// execução ou escreve o resultado; registrador cujo Qi muda; endereço escrito
+struct Breakpoint {
+    int tipo;
+    int alvo;
+};
+
+// Células de memória mostradas por quadro (as de menor endereço), para que o
+// quadro não cresça com a quantidade de células escritas
+const size_t CELULAS_NA_TELA = 32;
+
+// Estado de um ciclo como mostrarEstado o exibe, copiado pelo núcleo de
+// simulação. As unidades são cópias por valor; dos ponteiros que carregam só
+// 'instrucao' é lido, e ele aponta para o programa, que não muda.
+struct Instantaneo {
+    struct LinhaROB {
+        int entrada;
+        int indiceInstrucao;
+        const char* estado;
+        int destReg;
+        bool pronto;
+        int valor;
+    };
+    int ciclo = 0;
+    bool fim = false;                    // último quadro da simulação
+    vector<StatusInstrucao> status;      // registroVisivel de cada instrução
+    vector<BufferLoad> loads;
+    vector<BufferStore> stores;
+    vector<EstacaoReserva> estacoesAddSub;
+    vector<EstacaoReserva> estacoesMultDiv;
+    vector<Registrador> registradores;
+    vector<pair<int, int>> memoria;      // células tocadas (até CELULAS_NA_TELA)
+    size_t celulasTocadas = 0;           // total, para indicar as omitidas
+    vector<EstadoRegistrador> estadoRegistradores;
+    vector<int> fila;                    // índices na fila de instruções
+    int livres[NUM_GRUPOS_FU] = {};      // unidades funcionais livres no ciclo
+    int robOcupadas = 0;
+    vector<LinhaROB> rob;
+    string logEventos;
+};
+
+// Anel sem trava de um produtor (simulação) e um consumidor (interface). O
+// produtor reserva o próximo quadro livre, preenche e publica; com o anel
+// cheio o ciclo não é publicado, e a simulação nunca espera pelo terminal. O
+// consumidor pega só o mais novo e libera de uma vez os intermediários.
+struct AnelInstantaneos {
+    static const unsigned TAMANHO = 4;
+    Instantaneo quadros[TAMANHO];
+    atomic<unsigned> publicados{0};   // escrito só pelo produtor
+    atomic<unsigned> liberados{0};    // escrito só pelo consumidor
+    long long descartados = 0;        // ciclos não publicados (anel cheio)
+
+    Instantaneo* reservar() {
+        unsigned p = publicados.load(memory_order_relaxed);
+        if (p - liberados.load(memory_order_acquire) == TAMANHO) return nullptr;
+        return &quadros[p % TAMANHO];
+    }
+
+    void publicar() {
+        publicados.store(publicados.load(memory_order_relaxed) + 1, memory_order_release);
+    }
+
+    // Quadro mais novo publicado (nullptr se nenhum); fica reservado até liberar()
+    const Instantaneo* maisNovo() {
+        unsigned p = publicados.load(memory_order_acquire);
+        if (p == liberados.load(memory_order_relaxed)) return nullptr;
+        liberados.store(p - 1, memory_order_release);
+        return &quadros[(p - 1) % TAMANHO];
+    }
+
+    void liberar() {
+        liberados.store(liberados.load(memory_order_relaxed) + 1, memory_order_release);
+    }
+};
+
+// Núcleo do simulador
+struct Tomasulo {
+    string logEventos;
+    int cicloAtual = 0;
+
+    // Estado da arquitetura, próprio de cada instância (o --varrer roda várias em paralelo)
+    vector<Registrador> registradores; // F0..Fn
+    Memoria memoria;
+
+    BufferLoad*  buffersCarregamento   = nullptr;
+    BufferStore* buffersArmazenamento  = nullptr;
+    EstacaoReserva* estacoesAddSub     = nullptr;
+    EstacaoReserva* estacoesMultDiv    = nullptr;
+    EstadoRegistrador* estadoRegistradores = nullptr;
+
+    int numBuffersCarregamento = 3;
+    int numBuffersArmazenamento = 3;
+    int numEstacoesAddSub = 3;
+    int numEstacoesMultDiv = 2;
+
+    int numTotalRegistradores = 0;
+    const Instrucao* instrucoes = nullptr;   // programa pré-decodificado
+    Instrucao* programaProprio = nullptr;    // decodificado do texto (new[])
+    ArquivoMapeado imagemPrograma;           // ou mapeado de Program_Image
+    StatusInstrucao* statusInstrucoes = nullptr; // última instância retirada de cada instrução
+    int numInstrucoes = 0;
+
+    int ciclosLS = 1;
+    int ciclosAddSub = 1;
+    int ciclosMult = 1;
+    int ciclosDiv = 1;
+
+    FilaLoadStore filaLS;
+    PreditorDependencias preditorMem;
+    HierarquiaMemoria caches;          // L1_*/L2_*/Memory_Cycles; sem L1, latência fixa ciclosLS
+    long long loadsIniciados = 0;
+    long long somaLatenciaLoads = 0;
+    long long loadsEspeculativos = 0;   // leram com STORE anterior sem endereço
+    long long violacoesMemoria = 0;
+    long long instrucoesReexecutadas = 0;
+
+    // Unidades funcionais (ver GrupoUnidades) e intervalos de iniciação
+    GrupoUnidades unidades[NUM_GRUPOS_FU];
+    int intervaloAddSub = 1;
+    int intervaloMult = 1;
+    int intervaloDiv = 1;
+    int intervaloLS = 1;
+    long long limiteOrdemFU[NUM_GRUPOS_FU]; // sequência da mais nova atendida no ciclo
+
+    int cdb_rr = 0; // 0=ADD/SUB/BNE, 1=MUL/DIV, 2=LOAD
+    int numCDBs = 1;
+    int politicaCDB = CDB_ROUND_ROBIN;
+    long long totalEsperaCDB = 0;  // soma das esperas por barramento
+    int maiorEsperaCDB = 0;
+    long long escritasCDB = 0;
+
+    vector<string> nomesUnidades;           // tag -> nome da unidade
+    vector<vector<Dependente>> dependentes; // tag -> consumidores aguardando
+
+    // Front end superescalar: busca em ordem para a fila, emissão de até
+    // larguraEmissao instruções por ciclo a partir da cabeça da fila
+    int larguraEmissao = 1;
+    int tamanhoFilaInstrucoes = 0;     // 0 = padrão derivado da largura
+    deque<InstrucaoBuscada> filaInstrucoes; // instruções buscadas e não emitidas
+    int proxBusca = 0;                 // próxima instrução a buscar
+    bool buscaBloqueada = false;       // busca parada após um BNE até sua resolução
+    long long contadorEmissao = 0;     // próximo número de sequência
+    PoolInstancias instancias;         // registros das instâncias em voo
+    EstatisticasRetiradas retiradas;
+
+    long long slotsSemUso[NUM_MOTIVOS_SLOT] = {};
+    vector<long long> slotsSemUsoPorEmitidas; // [k] = ciclos com k emissões
+
+    long long pilhaCPI[NUM_CATEGORIAS_CICLO] = {};
+    long long pilhaCPIPorClasse[NUM_CATEGORIAS_CICLO][NUM_CLASSES_INSTRUCAO] = {};
+    vector<array<long long, NUM_CATEGORIAS_CICLO>> ciclosPorUnidade; // tag -> ciclos por estado
+    int classeConcluida = -1;           // primeira instrução concluída no ciclo (-1 nenhuma)
+
+    bool modoBatch = false;       // sem entrada/saida por ciclo; so o resumo final
+    bool imprimirResumo = true;   // falso no --bench, que so le os contadores
+    bool saltarCiclosOciosos = true; // no modo batch, pula trechos em que so ha contagem regressiva
+    bool reproducaoAutomatica = false; // modo interativo sem ENTER (--auto)
+    int ciclosPorSegundo = 10;    // ritmo da reproducao automatica (0 = sem pausa)
+    int quadrosPorSegundo = 30;   // limite de redesenhos da reproducao automatica
+    int avancarAte = 0;           // --avancar: simula sem exibir ate este ciclo
+    int intervaloCheckpoint = 0;  // --checkpoint: grava a cada N ciclos (0 = nunca)
+    string prefixoCheckpoint;     // arquivos <prefixo>.<ciclo>.ckpt
+    vector<pair<string, string>> ajustesConfiguracao; // "Chave=valor": sobrepõem os do arquivo
+    bool modoFuncional = false;   // --funcional: so executa o programa, sem modelar tempo
+    long long periodoAmostragem = 0;    // --amostragem: instrucoes por periodo (0 = sem amostragem)
+    long long janelaAmostragem = 0;     // instrucoes medidas em detalhe em cada periodo
+    long long aquecimentoAmostragem = 0; // instrucoes detalhadas antes da janela, nao medidas
+    bool buscaSuspensa = false;   // amostragem: esvazia o pipeline sem buscar instrucoes
+
+    // Depurador do modo interativo (ver depurar)
+    vector<Breakpoint> breakpoints;
+    HistoricoEstados historicoEstados;
+    RegistroEscritas* escritas = nullptr; // ligado nos ciclos que o histórico ainda não tem
+    vector<int> enderecosEscritos; // gravados na memória no ciclo (breakpoints de memória)
+    int instrucoesConcluidas = 0; // instrucoes dinamicas que escreveram resultado
+
+    bool branchPending = false;
+    bool branchResolved = false;
+    bool branchTaken = false;
+    int branchTarget = -1;
+    int branchIssuedIndex = -1;
+
+    // Buffer de reordenação: com ROB_Size > 0 o commit é em ordem e a emissão
+    // continua especulativamente após um BNE, pelo caminho previsto
+    int tamanhoROB = 0;
+    EntradaROB* rob = nullptr;
+    int robCabeca = 0;
+    int robCauda = 0;
+    int robOcupadas = 0;
+    PreditorDesvio preditor;
+    long long desviosResolvidos = 0;
+    long long desviosErrados = 0;
+    long long instrucoesDescartadas = 0;
+    long long ciclosPenalidade = 0;    // soma de (resolução - emissão) dos desvios errados
+
+    int lerMemoria(int endereco) const {
+        return memoria.ler(endereco);
+    }
+
+    void escreverMemoria(int endereco, int valor) {
+        memoria.escrever(endereco, valor);
+    }
+
+    void escreverRegistrador(int r, int valor) {
+        if (escritas) escritas->anotar(&registradores[r].valor, sizeof(int));
+        registradores[r].valor = valor;
+    }
+
+    int eNumero(const string& s) const {
+        return all_of(s.begin(), s.end(),
+                      [](unsigned char c){ return std::isdigit(c); }) ? 1 : 0;
+    }
+
+    static int obterValorOperando(const string& operando) {
+        if (operando.empty()) return 0;
+        try { return stoi(operando); }
+        catch (...) { return 0; }
+    }
+
+    static bool isValueReadyString(const string& s) {
+        if (s.empty()) return false;
+        size_t i = (s[0] == '+' || s[0] == '-') ? 1 : 0;
+        if (i >= s.size()) return false;
+        return all_of(s.begin() + i, s.end(),
+                      [](unsigned char c){ return std::isdigit(c); });
+    }
+
+    // "F<n>" ou "f<n>", existindo ou não o registrador
+    static bool nomeDeRegistrador(const string& r) {
+        if (r.size() < 2 || r.size() > 6 || (r[0] != 'F' && r[0] != 'f')) return false;
+        return all_of(r.begin() + 1, r.end(), [](unsigned char c){ return std::isdigit(c); });
+    }
+
+    int regIndex(const string& r) const {
+        if (!nomeDeRegistrador(r)) return -1;
+        int n = atoi(r.c_str() + 1);
+        if (n < 0 || n >= numTotalRegistradores) return -1;
+        return n;
+    }
+
+    int registrarUnidade(const string& nome) {
+        nomesUnidades.push_back(nome);
+        dependentes.emplace_back();
+        ciclosPorUnidade.push_back({});
+        return (int)nomesUnidades.size() - 1;
+    }
+
+    string nomeTag(int tag) const {
+        return tag == SEM_UNIDADE ? "" : nomesUnidades[tag];
+    }
+
+    // Le o operando do registrador: valor se pronto, senao aguarda a tag produtora
+    // (com ROB: valor do ROB se a entrada produtora já escreveu no CDB).
+    // 'baseLoad'/'baseStore': o operando é a base desse buffer.
+    void lerOperando(int regIdx, int& origem, int& valor,
+                     BufferLoad* baseLoad = nullptr, BufferStore* baseStore = nullptr,
+                     bool dadoStore = false) {
+        if (tamanhoROB > 0) {
+            int e = estadoRegistradores[regIdx].entradaROB;
+            if (e == -1) {
+                origem = SEM_UNIDADE;
+                valor = registradores[regIdx].valor;
+            } else if (rob[e].pronto) {
+                origem = SEM_UNIDADE;
+                valor = rob[e].valor;
+            } else {
+                origem = rob[e].unidade;
+                dependentes[origem].push_back({ &origem, &valor, baseLoad, baseStore, dadoStore });
+            }
+            return;
+        }
+        origem = estadoRegistradores[regIdx].unidadeEscritora;
+        if (origem == SEM_UNIDADE)
+            valor = registradores[regIdx].valor;
+        else
+            dependentes[origem].push_back({ &origem, &valor, baseLoad, baseStore, dadoStore });
+    }
+
+    // Marca a unidade como próxima escritora do registrador destino
+    void definirEscritor(int regIdx, int unidade, int entradaROB) {
+        if (tamanhoROB > 0)
+            estadoRegistradores[regIdx].entradaROB = entradaROB;
+        else
+            estadoRegistradores[regIdx].unidadeEscritora = unidade;
+    }
+
+    // Arquivo texto de memória inicial: linhas "endereco valor"; '#' inicia comentário
+    void carregarMemoriaTexto(const string& nomeArquivo) {
+        ifstream leitura(nomeArquivo);
+        if (!leitura.is_open()) {
+            cout << "O arquivo de memoria nao pode ser aberto: " << nomeArquivo << endl;
+            exit(EXIT_FAILURE);
+        }
+        string linha;
+        int numLinha = 0;
+        while (getline(leitura, linha)) {
+            numLinha++;
+            size_t c = linha.find('#');
+            if (c != string::npos) linha.erase(c);
+            istringstream ss(linha);
+            int endereco, valor;
+            if (!(ss >> endereco)) continue;
+            if (!(ss >> valor)) {
+                cout << nomeArquivo << ":" << numLinha << ": valor ausente para o endereco "
+                     << endereco << ".\n";
+                exit(EXIT_FAILURE);
+            }
+            escreverMemoria(endereco, valor);
+        }
+    }
+
+    void carregarDadosDoArquivo(const string& nomeArquivo) {
+        LeitorFonte fonte;
+        if (!fonte.abrir(nomeArquivo)) {
+            cout << "O arquivo de entrada nao pode ser aberto: " << nomeArquivo << endl;
+            if (!modoBatch) pausar();
+            exit(EXIT_FAILURE);
+        }
+        carregarDados(fonte);
+    }
+
+    // Mesmo formato do arquivo de entrada, a partir de um texto em memória
+    void carregarDadosDoTexto(const string& nome, const string& texto) {
+        LeitorFonte fonte;
+        fonte.abrirTexto(nome, texto);
+        carregarDados(fonte);
+    }
+
+    void carregarDados(LeitorFonte& fonte) {
+        // Parâmetros "Chave valor", todos opcionais, até a declaração de
+        // registradores; os ajustes "Chave=valor" (ajustesConfiguracao) vêm
+        // depois e prevalecem. Erros de um ajuste saem sem número de linha.
+        int linhaCache[2] = { 0, 0 };  // última linha com chave de cada nível (erros de geometria)
+        int linhaPrefetcher = 0;
+        auto definirParametro = [&](const string& linhaDados, const string& valorTexto, int linha) {
+            if (linhaDados == "Branch_Predictor") {
+                int p = 0;
+                while (p < 3 && valorTexto != NOMES_PREDITORES[p]) p++;
+                if (p == 3) fonte.erro(linha, "Preditor de desvios desconhecido: " + valorTexto);
+                preditor.tipo = p;
+                return;
+            }
+            if (linhaDados == "Memory_Dependence_Predictor") {
+                if (valorTexto != "None" && valorTexto != "StoreSets")
+                    fonte.erro(linha, "Preditor de dependencias desconhecido: " + valorTexto);
+                preditorMem.ativo = valorTexto == "StoreSets";
+                return;
+            }
+            bool chaveCache = linhaDados.size() > 3 && linhaDados[0] == 'L' &&
+                              (linhaDados[1] == '1' || linhaDados[1] == '2') && linhaDados[2] == '_';
+            if (chaveCache) linhaCache[linhaDados[1] - '1'] = linha;
+            if (chaveCache && linhaDados.compare(3, string::npos, "Replacement") == 0) {
+                int p = 0;
+                while (p < NUM_POLITICAS_SUBST && valorTexto != NOMES_POLITICAS_SUBST[p]) p++;
+                if (p == NUM_POLITICAS_SUBST) fonte.erro(linha, "Politica de substituicao desconhecida: " + valorTexto);
+                caches.niveis[linhaDados[1] - '1'].politica = p;
+                return;
+            }
+            if (linhaDados == "Prefetcher") {
+                int p = 0;
+                while (p < NUM_TIPOS_PREFETCHER && valorTexto != NOMES_PREFETCHERS[p]) p++;
+                if (p == NUM_TIPOS_PREFETCHER) fonte.erro(linha, "Prefetcher desconhecido: " + valorTexto);
+                caches.prefetcher.tipo = p;
+                linhaPrefetcher = linha;
+                return;
+            }
+            if (linhaDados == "CDB_Policy") {
+                int p = 0;
+                while (p < 4 && valorTexto != NOMES_POLITICAS_CDB[p]) p++;
+                if (p == 4) fonte.erro(linha, "Politica de CDB desconhecida: " + valorTexto);
+                politicaCDB = p;
+                return;
+            }
+            int valor;
+            if (!converterInteiro(valorTexto, valor))
+                fonte.erro(linha, "Valor invalido para o parametro " + linhaDados + ".");
+            if (linhaDados == "Add_Sub_Reservation_Stations")
+                numEstacoesAddSub = valor;
+            else if (linhaDados == "Mul_Div_Reservation_Stations")
+                numEstacoesMultDiv = valor;
+            else if (linhaDados == "Load_Buffers")
+                numBuffersCarregamento = valor;
+            else if (linhaDados == "Store_Buffers")
+                numBuffersArmazenamento = valor;
+            else if (linhaDados == "Add_Sub_Cycles")
+                ciclosAddSub = valor;
+            else if (linhaDados == "Mul_Cycles")
+                ciclosMult = valor;
+            else if (linhaDados == "Load_Store_Cycles")
+                ciclosLS = valor;
+            else if (linhaDados == "Div_Cycles")
+                ciclosDiv = valor;
+            else if (linhaDados == "Add_Sub_Units")
+                unidades[FU_ADD_SUB].quantidade = valor;
+            else if (linhaDados == "Mul_Div_Units")
+                unidades[FU_MUL_DIV].quantidade = valor;
+            else if (linhaDados == "Load_Store_Units")
+                unidades[FU_LOAD_STORE].quantidade = valor;
+            else if (linhaDados == "Add_Sub_Interval")
+                intervaloAddSub = valor;
+            else if (linhaDados == "Mul_Interval")
+                intervaloMult = valor;
+            else if (linhaDados == "Div_Interval")
+                intervaloDiv = valor;
+            else if (linhaDados == "Load_Store_Interval")
+                intervaloLS = valor;
+            else if (linhaDados == "Issue_Width")
+                larguraEmissao = valor;
+            else if (linhaDados == "Instruction_Queue_Size")
+                tamanhoFilaInstrucoes = valor;
+            else if (linhaDados == "CDB_Count")
+                numCDBs = valor;
+            else if (linhaDados == "ROB_Size")
+                tamanhoROB = valor;
+            else if (linhaDados == "Predictor_Bits")
+                preditor.bitsTabela = valor;
+            else if (linhaDados == "Store_Set_Bits")
+                preditorMem.bits = valor;
+            else if (linhaDados == "Memory_Cycles")
+                caches.latenciaMemoria = valor;
+            else if (linhaDados == "Memory_Ports")
+                caches.numPortas = valor;
+            else if (linhaDados == "MSHR_Count")
+                caches.numMSHRs = valor;
+            else if (linhaDados == "Memory_Banks")
+                caches.numBancos = valor;
+            else if (linhaDados == "Bank_Busy_Cycles")
+                caches.ocupacaoBanco = valor;
+            else if (linhaDados == "Prefetch_Degree")
+                caches.prefetcher.grau = valor;
+            else if (linhaDados == "Stride_Table_Bits")
+                caches.prefetcher.bitsTabela = valor;
+            else if (linhaDados == "Stream_Buffers")
+                caches.prefetcher.numStreams = valor;
+            else if (linhaDados == "Stream_Buffer_Depth")
+                caches.prefetcher.profundidade = valor;
+            else if (chaveCache) {
+                Cache& c = caches.niveis[linhaDados[1] - '1'];
+                string campo = linhaDados.substr(3);
+                if (campo == "Size")
+                    c.tamanho = valor;
+                else if (campo == "Associativity")
+                    c.associatividade = valor;
+                else if (campo == "Line_Size")
+                    c.tamanhoLinha = valor;
+                else if (campo == "Hit_Cycles")
+                    c.latencia = valor;
+                else
+                    fonte.erro(linha, "Parametro desconhecido: " + linhaDados);
+            } else
+                fonte.erro(linha, "Parametro desconhecido: " + linhaDados);
+        };
+        string linhaDados;
+        while ((linhaDados = fonte.ler("Registers")) != "Registers") {
+            definirParametro(linhaDados, fonte.lerNaLinha("valor de " + linhaDados), fonte.linha);
+            if (!fonte.fimDaLinha()) fonte.erro("valor a mais para " + linhaDados + ": " + fonte.espiar());
+        }
+        for (const auto& a : ajustesConfiguracao) definirParametro(a.first, a.second, 0);
+
+        ciclosAddSub = max(1, ciclosAddSub);
+        ciclosMult   = max(1, ciclosMult);
+        ciclosDiv    = max(1, ciclosDiv);
+        ciclosLS     = max(1, ciclosLS);
+        intervaloAddSub = min(max(1, intervaloAddSub), ciclosAddSub);
+        intervaloMult   = min(max(1, intervaloMult), ciclosMult);
+        intervaloDiv    = min(max(1, intervaloDiv), ciclosDiv);
+        intervaloLS     = min(max(1, intervaloLS), ciclosLS);
+        for (int n = 0; n < 2; n++) {
+            Cache& c = caches.niveis[n];
+            c.tamanho = max(0, c.tamanho);
+            if (c.tamanho == 0) continue;
+            string erro = c.validar();
+            if (!erro.empty()) fonte.erro(linhaCache[n], "cache L" + to_string(n + 1) + ": " + erro);
+        }
+        if (caches.niveis[1].tamanho > 0 && !caches.ativa())
+            fonte.erro(linhaCache[1], "cache L2 exige L1 (L1_Size)");
+        caches.latenciaMemoria = max(1, caches.latenciaMemoria);
+        caches.latenciaSemCache = ciclosLS;
+        caches.numPortas = max(0, caches.numPortas);
+        caches.numMSHRs = max(0, caches.numMSHRs);
+        caches.numBancos = max(0, caches.numBancos);
+        caches.ocupacaoBanco = max(1, caches.ocupacaoBanco);
+        Prefetcher& pf = caches.prefetcher;
+        if (pf.tipo != PREF_NENHUM && !caches.ativa())
+            fonte.erro(linhaPrefetcher, "Prefetcher exige cache L1 (L1_Size)");
+        pf.grau = max(1, pf.grau);
+        pf.bitsTabela = min(max(1, pf.bitsTabela), 20);
+        pf.numStreams = max(1, pf.numStreams);
+        pf.profundidade = max(1, pf.profundidade);
+        caches.iniciar();
+        const char* nomesGrupos[NUM_GRUPOS_FU] = { "ADD/SUB", "MUL/DIV", "LOAD/STORE" };
+        for (int g = 0; g < NUM_GRUPOS_FU; g++) {
+            unidades[g].nome = nomesGrupos[g];
+            unidades[g].quantidade = max(0, unidades[g].quantidade);
+            unidades[g].iniciar();
+        }
+        larguraEmissao = max(1, larguraEmissao);
+        numCDBs = max(1, numCDBs);
+        tamanhoROB = max(0, tamanhoROB);
+        preditor.bitsTabela = min(max(1, preditor.bitsTabela), 20);
+        preditor.iniciar();
+        if (tamanhoROB > 0) rob = new EntradaROB[tamanhoROB];
+        if (preditorMem.ativo && tamanhoROB == 0) {
+            // Sem ROB não há como reexecutar um LOAD que já escreveu no CDB
+            cout << "Memory_Dependence_Predictor requer ROB_Size > 0." << endl;
+            exit(EXIT_FAILURE);
+        }
+        preditorMem.bits = min(max(1, preditorMem.bits), 20);
+        // Janela: cada instância em voo ocupa uma entrada do ROB ou uma estação/buffer
+        instancias.iniciar(tamanhoROB > 0 ? tamanhoROB
+                           : numEstacoesAddSub + numEstacoesMultDiv +
+                             numBuffersCarregamento + numBuffersArmazenamento);
+        preditorMem.iniciar();
+        if (tamanhoFilaInstrucoes <= 0) tamanhoFilaInstrucoes = max(4, 2 * larguraEmissao);
+        tamanhoFilaInstrucoes = max(larguraEmissao, tamanhoFilaInstrucoes);
+        slotsSemUsoPorEmitidas.assign(larguraEmissao + 1, 0);
+
+        buffersCarregamento = new BufferLoad[numBuffersCarregamento];
+        for (int i = 0; i < numBuffersCarregamento; i++) {
+            buffersCarregamento[i].nome = TipoBufferLS::CARREGA + to_string(i);
+            buffersCarregamento[i].id = registrarUnidade(buffersCarregamento[i].nome);
+        }
+
+        buffersArmazenamento = new BufferStore[numBuffersArmazenamento];
+        for (int i = 0; i < numBuffersArmazenamento; i++) {
+            buffersArmazenamento[i].nome = TipoBufferLS::ARMAZENA + to_string(i);
+            buffersArmazenamento[i].id = registrarUnidade(buffersArmazenamento[i].nome);
+        }
+
+        estacoesAddSub = new EstacaoReserva[numEstacoesAddSub];
+        for (int i = 0; i < numEstacoesAddSub; i++) {
+            estacoesAddSub[i].nome = TipoEstacaoReserva::ADIC_SUB + to_string(i);
+            estacoesAddSub[i].id = registrarUnidade(estacoesAddSub[i].nome);
+        }
+
+        estacoesMultDiv = new EstacaoReserva[numEstacoesMultDiv];
+        for (int i = 0; i < numEstacoesMultDiv; i++) {
+            estacoesMultDiv[i].nome = TipoEstacaoReserva::MULT_DIV + to_string(i);
+            estacoesMultDiv[i].id = registrarUnidade(estacoesMultDiv[i].nome);
+        }
+
+        numTotalRegistradores = fonte.lerInteiro("numero de registradores", true);
+        if (numTotalRegistradores < 0 || numTotalRegistradores >= SEM_REGISTRADOR)
+            fonte.erro("Registers deve estar entre 0 e " + to_string(SEM_REGISTRADOR - 1) + ".");
+        estadoRegistradores = new EstadoRegistrador[numTotalRegistradores];
+
+        for (int i = 0; i < numTotalRegistradores; i++) {
+            estadoRegistradores[i].nomeRegistrador = "F" + to_string(i);
+            Registrador r;
+            r.nome = "F" + to_string(i);
+            r.valor = 0;
+            registradores.push_back(r);
+        }
+
+        // Inicializações opcionais (registradores e memória) antes do programa
+        while (fonte.haToken()) {
+            string token = fonte.espiar();
+            if (nomeDeRegistrador(token)) {
+                // Outro nome (FOO, rótulo...) já é o programa: fica para o montador
+                fonte.ler(token);
+                int val = fonte.lerInteiro("valor inicial de " + token, true);
+                int idx = regIndex(token);
+                if (idx < 0) fonte.erro("Registrador invalido na inicializacao: " + token);
+                registradores[idx].valor = val;
+            } else if (token == "Memory") {
+                fonte.ler(token);
+                int n = fonte.lerInteiro("quantidade de posicoes em Memory", true);
+                for (int k = 0; k < n; k++) {
+                    int endereco = fonte.lerInteiro("endereco da posicao " + to_string(k) + " de Memory");
+                    int valor = fonte.lerInteiro("valor da posicao " + to_string(k) + " de Memory", true);
+                    escreverMemoria(endereco, valor);
+                }
+            } else if (token == "Memory_File") {
+                fonte.ler(token);
+                carregarMemoriaTexto(fonte.lerNaLinha("arquivo de Memory_File"));
+            } else if (token == "Memory_Image") {
+                fonte.ler(token);
+                string arquivo = fonte.lerNaLinha("arquivo de Memory_Image");
+                int base = fonte.lerInteiro("endereco base de Memory_Image", true);
+                string erro;
+                if (!memoria.mapearImagem(arquivo, base, erro))
+                    fonte.erro("Erro ao mapear imagem de memoria " + arquivo + ": " + erro);
+            } else if (token == "Program_Image") {
+                // Programa binário no lugar da lista de instruções
+                fonte.ler(token);
+                mapearPrograma(fonte.lerNaLinha("arquivo de Program_Image"));
+                return;
+            } else {
+                break;
+            }
+        }
+
+        // Contagem de instruções antes da lista: formato antigo, ainda aceito
+        int limite = -1;
+        if (fonte.haToken() && converterInteiro(fonte.espiar(), limite)) {
+            fonte.ler("numero de instrucoes");
+            if (limite < 0) fonte.erro("numero de instrucoes negativo");
+        }
+        montarPrograma(fonte, limite);
+    }
+
+    // Montador: uma instrução por linha, opcionalmente precedida de rótulos
+    // "nome:". O alvo de BNE/BEQ é um rótulo ou um deslocamento numérico em
+    // relação à instrução seguinte; rótulos viram deslocamentos aqui mesmo, e o
+    // programa resultante não guarda nenhum texto. Com 'limite' >= 0 (contagem
+    // no arquivo) lê exatamente essa quantidade de instruções.
+    void montarPrograma(LeitorFonte& fonte, int limite) {
+        struct AlvoPendente {
+            int indice;
+            string rotulo;
+            int linha;
+        };
+        vector<Instrucao> programa;
+        unordered_map<string, int> rotulos;
+        vector<AlvoPendente> pendentes;
+
+        while ((limite < 0 || (int)programa.size() < limite) && fonte.haToken()) {
+            string token = fonte.ler("instrucao");
+            int linha = fonte.linha;
+            if (token.size() > 1 && token.back() == ':') {
+                string rotulo = token.substr(0, token.size() - 1);
+                if (!rotulos.emplace(rotulo, (int)programa.size()).second)
+                    fonte.erro("rotulo repetido: " + rotulo);
+                continue;
+            }
+            string mnemonico = token;
+            for (char& ch : mnemonico) ch = (char)toupper((unsigned char)ch);
+            int t = 0;
+            while (t < TiposInstrucao::NUM_TIPOS && mnemonico != NOMES_TIPOS_INSTRUCAO[t]) t++;
+            if (t == TiposInstrucao::NUM_TIPOS) fonte.erro("instrucao desconhecida: " + token);
+
+            Instrucao instr;
+            instr.tipoInstrucao = (uint8_t)t;
+            instr.regDestino = instr.regFonte1 = instr.regFonte2 = SEM_REGISTRADOR;
+            instr.offsetImediato = 0;
+            switch (t) {
+            case TiposInstrucao::SOMA:
+            case TiposInstrucao::SUBT:
+            case TiposInstrucao::MULT:
+            case TiposInstrucao::DIVI:
+                instr.regDestino = lerRegistrador(fonte);
+                instr.regFonte1 = lerRegistrador(fonte);
+                instr.regFonte2 = lerRegistrador(fonte);
+                break;
+            case TiposInstrucao::SOMA_IMED:
+            case TiposInstrucao::SUBT_IMED:
+            case TiposInstrucao::MULT_IMED:
+            case TiposInstrucao::DIVI_IMED:
+                instr.regDestino = lerRegistrador(fonte);
+                instr.regFonte1 = lerRegistrador(fonte);
+                instr.offsetImediato = fonte.lerInteiro("imediato", true);
+                break;
+            case TiposInstrucao::CARREGA:
+            case TiposInstrucao::ARMAZENA:
+                instr.regFonte2 = lerRegistrador(fonte);                // Rt (destino no LOAD, valor no STORE)
+                instr.offsetImediato = fonte.lerInteiro("offset", true); // offset
+                instr.regFonte1 = lerRegistrador(fonte);                // Rs (base)
+                break;
+            case TiposInstrucao::BNE:
+            case TiposInstrucao::BEQ: {
+                instr.regFonte1 = lerRegistrador(fonte); // Rs
+                instr.regFonte2 = lerRegistrador(fonte); // Rt
+                string alvo = fonte.lerNaLinha("alvo do desvio");
+                if (!converterInteiro(alvo, instr.offsetImediato))
+                    pendentes.push_back({ (int)programa.size(), alvo, linha });
+                break;
+            }
+            default: // NOP
+                break;
+            }
+            if (!fonte.fimDaLinha()) fonte.erro("operando a mais: " + fonte.espiar());
+            if (!haUnidadePara(t)) fonte.erro(mnemonico + " sem estacao ou buffer configurado");
+            programa.push_back(instr);
+        }
+        if (limite >= 0 && (int)programa.size() < limite)
+            fonte.erro("esperadas " + to_string(limite) + " instrucoes, encontradas " +
+                       to_string(programa.size()));
+
+        for (const AlvoPendente& p : pendentes) {
+            auto it = rotulos.find(p.rotulo);
+            if (it == rotulos.end()) fonte.erro(p.linha, "rotulo indefinido: " + p.rotulo);
+            programa[p.indice].offsetImediato = it->second - (p.indice + 1);
+        }
+
+        numInstrucoes = (int)programa.size();
+        programaProprio = new Instrucao[numInstrucoes];
+        copy(programa.begin(), programa.end(), programaProprio);
+        instrucoes = programaProprio;
+        statusInstrucoes = new StatusInstrucao[numInstrucoes];
+    }
+
+    // Lê um operando registrador da linha atual e o converte para o índice
+    uint8_t lerRegistrador(LeitorFonte& fonte) {
+        string nome = fonte.lerNaLinha("registrador");
+        int idx = regIndex(nome);
+        if (idx < 0) fonte.erro("Registrador invalido: " + nome);
+        return (uint8_t)idx;
+    }
+
+    // Sem estação/buffer da classe a instrução nunca seria emitida
+    bool haUnidadePara(int tipo) const {
+        switch (operacaoBase((uint8_t)tipo)) {
+        case TiposInstrucao::SOMA:
+        case TiposInstrucao::SUBT:
+        case TiposInstrucao::BNE:
+        case TiposInstrucao::BEQ:
+            return numEstacoesAddSub > 0;
+        case TiposInstrucao::MULT:
+        case TiposInstrucao::DIVI:
+            return numEstacoesMultDiv > 0;
+        case TiposInstrucao::CARREGA:
+            return numBuffersCarregamento > 0;
+        case TiposInstrucao::ARMAZENA:
+            return numBuffersArmazenamento > 0;
+        default:
+            return true;
+        }
+    }
+
+    // Confere cada registro de um programa binário uma vez, na carga: código,
+    // registradores usados, alvo dos desvios e unidade para a instrução.
+    // Devolve a primeira falha (vazio se o programa é válido).
+    string validarPrograma() const {
+        for (int i = 0; i < numInstrucoes; i++) {
+            const Instrucao& instr = instrucoes[i];
+            uint8_t tipo = instr.tipoInstrucao;
+            string onde = "instrucao " + to_string(i) + ": ";
+            if (tipo >= TiposInstrucao::NUM_TIPOS) return onde + "codigo " + to_string(tipo) + " invalido";
+            if (tipo == TiposInstrucao::NOP) continue;
+            bool usaDestino = !ehDesvio(tipo) && tipo != TiposInstrucao::CARREGA && tipo != TiposInstrucao::ARMAZENA;
+            bool usaFonte2 = !ehImediato(tipo);
+            if (instr.regFonte1 >= numTotalRegistradores ||
+                (usaFonte2 && instr.regFonte2 >= numTotalRegistradores) ||
+                (usaDestino && instr.regDestino >= numTotalRegistradores))
+                return onde + "registrador fora de Registers";
+            if (ehDesvio(tipo)) {
+                long long alvo = (long long)i + 1 + instr.offsetImediato;
+                if (alvo < 0 || alvo > numInstrucoes) return onde + "alvo do desvio fora do programa";
+            }
+            if (!haUnidadePara(tipo))
+                return onde + NOMES_TIPOS_INSTRUCAO[tipo] + " sem estacao ou buffer configurado";
+        }
+        return "";
+    }
+
+    // Usa um programa binário (salvarPrograma) direto do mapeamento, sem
+    // interpretar texto; os registros são conferidos uma vez (validarPrograma)
+    void mapearPrograma(const string& nomeArquivo) {
+        string erro;
+        if (imagemPrograma.abrir(nomeArquivo, erro)) {
+            const CabecalhoPrograma* cab = (const CabecalhoPrograma*)imagemPrograma.base;
+            if (imagemPrograma.bytes < sizeof(CabecalhoPrograma) ||
+                memcmp(cab->assinatura, ASSINATURA_PROGRAMA, sizeof(cab->assinatura)) != 0)
+                erro = "assinatura invalida";
+            else if (cab->versao != VERSAO_PROGRAMA)
+                erro = "versao " + to_string(cab->versao) + " nao suportada";
+            else if ((imagemPrograma.bytes - sizeof(CabecalhoPrograma)) / sizeof(Instrucao) <
+                     cab->numInstrucoes || cab->numInstrucoes > (uint32_t)INT32_MAX)
+                erro = "arquivo truncado";
+            else {
+                numInstrucoes = (int)cab->numInstrucoes;
+                instrucoes = (const Instrucao*)(cab + 1);
+                erro = validarPrograma();
+                if (erro.empty()) {
+                    statusInstrucoes = new StatusInstrucao[numInstrucoes];
+                    return;
+                }
+            }
+        }
+        cout << "Erro ao mapear programa " << nomeArquivo << ": " << erro << endl;
+        exit(EXIT_FAILURE);
+    }
+
+    // Grava o programa pré-decodificado no formato lido por Program_Image
+    void salvarPrograma(const string& nomeArquivo) const {
+        ofstream saida(nomeArquivo, ios::binary);
+        CabecalhoPrograma cab = {};
+        memcpy(cab.assinatura, ASSINATURA_PROGRAMA, sizeof(cab.assinatura));
+        cab.versao = VERSAO_PROGRAMA;
+        cab.numInstrucoes = (uint32_t)numInstrucoes;
+        saida.write((const char*)&cab, sizeof(cab));
+        // Desvios gravados com o alvo já limitado ao programa, como o usa alvoDesvio
+        vector<Instrucao> programa(instrucoes, instrucoes + numInstrucoes);
+        for (int i = 0; i < numInstrucoes; i++)
+            if (ehDesvio(programa[i].tipoInstrucao)) programa[i].offsetImediato = alvoDesvio(i) - (i + 1);
+        saida.write((const char*)programa.data(), (streamsize)numInstrucoes * sizeof(Instrucao));
+        if (!saida) {
+            cout << "Erro ao gravar programa em " << nomeArquivo << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // FNV-1a das instruções: o checkpoint só vale para o mesmo programa
+    long long impressaoPrograma() const {
+        uint64_t h = 1469598103934665603ULL;
+        const unsigned char* b = (const unsigned char*)instrucoes;
+        for (size_t i = 0; i < (size_t)numInstrucoes * sizeof(Instrucao); i++) {
+            h ^= b[i];
+            h *= 1099511628211ULL;
+        }
+        return (long long)h;
+    }
+
+    // Grava a configuração; na leitura, confere com a atual
+    void conferirConfiguracao(Checkpoint& c) {
+        const pair<const char*, long long> maquina[] = {
+            { "Add_Sub_Reservation_Stations", numEstacoesAddSub },
+            { "Mul_Div_Reservation_Stations", numEstacoesMultDiv },
+            { "Load_Buffers", numBuffersCarregamento },
+            { "Store_Buffers", numBuffersArmazenamento },
+            { "Add_Sub_Cycles", ciclosAddSub },
+            { "Mul_Cycles", ciclosMult },
+            { "Load_Store_Cycles", ciclosLS },
+            { "Div_Cycles", ciclosDiv },
+            { "Add_Sub_Units", unidades[FU_ADD_SUB].quantidade },
+            { "Mul_Div_Units", unidades[FU_MUL_DIV].quantidade },
+            { "Load_Store_Units", unidades[FU_LOAD_STORE].quantidade },
+            { "Add_Sub_Interval", intervaloAddSub },
+            { "Mul_Interval", intervaloMult },
+            { "Div_Interval", intervaloDiv },
+            { "Load_Store_Interval", intervaloLS },
+            { "Issue_Width", larguraEmissao },
+            { "Instruction_Queue_Size", tamanhoFilaInstrucoes },
+            { "CDB_Count", numCDBs },
+            { "CDB_Policy", politicaCDB },
+            { "ROB_Size", tamanhoROB },
+            { "Branch_Predictor", preditor.tipo },
+            { "Predictor_Bits", preditor.bitsTabela },
+            { "Memory_Dependence_Predictor", preditorMem.ativo },
+            { "Store_Set_Bits", preditorMem.bits },
+            { "L1_Size", caches.niveis[0].tamanho },
+            { "L1_Associativity", caches.niveis[0].associatividade },
+            { "L1_Line_Size", caches.niveis[0].tamanhoLinha },
+            { "L1_Hit_Cycles", caches.niveis[0].latencia },
+            { "L1_Replacement", caches.niveis[0].politica },
+            { "L2_Size", caches.niveis[1].tamanho },
+            { "L2_Associativity", caches.niveis[1].associatividade },
+            { "L2_Line_Size", caches.niveis[1].tamanhoLinha },
+            { "L2_Hit_Cycles", caches.niveis[1].latencia },
+            { "L2_Replacement", caches.niveis[1].politica },
+            { "Memory_Cycles", caches.latenciaMemoria },
+            { "Memory_Ports", caches.numPortas },
+            { "MSHR_Count", caches.numMSHRs },
+            { "Memory_Banks", caches.numBancos },
+            { "Bank_Busy_Cycles", caches.ocupacaoBanco },
+            { "Prefetcher", caches.prefetcher.tipo },
+            { "Prefetch_Degree", caches.prefetcher.grau },
+            { "Stride_Table_Bits", caches.prefetcher.bitsTabela },
+            { "Stream_Buffers", caches.prefetcher.numStreams },
+            { "Stream_Buffer_Depth", caches.prefetcher.profundidade },
+            { "Registers", numTotalRegistradores },
+            { "numero de instrucoes", numInstrucoes },
+            { "programa", impressaoPrograma() },
+        };
+        c.secao();
+        for (const auto& p : maquina) c.conferir(p.second, p.first);
+    }
+
+    // Grava ou lê (c.gravando) todo o estado que muda durante a simulação.
+    // Configuração e nomes não são gravados, só conferidos: o checkpoint é
+    // restaurado sobre o mesmo arquivo de entrada já carregado. Com c.soNucleo
+    // ficam de fora a configuração e o que o depurador volta pelo registro de
+    // desfazer: memória, valores dos registradores, registros por instrução e
+    // tabelas (caches, preditores, prefetcher).
+    void transferirEstado(Checkpoint& c) {
+        if (!c.soNucleo) conferirConfiguracao(c);
+        if (!c.erro.empty()) return;
+
+        StatusInstrucao* pool = instancias.anel.data();
+        int tamanhoPool = (int)instancias.anel.size();
+        c.secao();
+        c.campo(cicloAtual);
+        c.texto(logEventos);
+
+        for (int i = 0; i < numBuffersCarregamento; i++) {
+            BufferLoad& lb = buffersCarregamento[i];
+            c.secao();
+            c.campo(lb.ocupado); c.campo(lb.baseVal); c.campo(lb.origemBase); c.campo(lb.offset);
+            c.campo(lb.destReg); c.campo(lb.ciclosRestantes); c.campo(lb.latencia); c.campo(lb.fimEspera);
+            c.campo(lb.resultReady); c.campo(lb.resultado); c.campo(lb.hasForward); c.campo(lb.forwardVal);
+            c.indice(lb.instrucao, instrucoes, numInstrucoes);
+            c.indice(lb.status, pool, tamanhoPool);
+            c.campo(lb.entradaROB); c.campo(lb.naFila); c.campo(lb.enderecoIndexado); c.campo(lb.endereco);
+            c.campo(lb.especulativo); c.campo(lb.ordemFonte); c.campo(lb.esperaStore);
+        }
+        for (int i = 0; i < numBuffersArmazenamento; i++) {
+            BufferStore& sb = buffersArmazenamento[i];
+            c.secao();
+            c.campo(sb.ocupado); c.campo(sb.baseVal); c.campo(sb.origemBase); c.campo(sb.offset);
+            c.campo(sb.value); c.campo(sb.origemVal); c.campo(sb.ciclosRestantes); c.campo(sb.fimEspera);
+            c.indice(sb.instrucao, instrucoes, numInstrucoes);
+            c.indice(sb.status, pool, tamanhoPool);
+            c.campo(sb.entradaROB); c.campo(sb.enderecoIndexado); c.campo(sb.endereco);
+        }
+        for (int g = 0; g < 2; g++) {
+            EstacaoReserva* ers = g == 0 ? estacoesAddSub : estacoesMultDiv;
+            int n = g == 0 ? numEstacoesAddSub : numEstacoesMultDiv;
+            for (int i = 0; i < n; i++) {
+                EstacaoReserva& er = ers[i];
+                c.secao();
+                c.campo(er.ocupado); c.campo(er.tipoInstrucao); c.campo(er.valorJ); c.campo(er.valorK);
+                c.campo(er.origemJ); c.campo(er.origemK); c.campo(er.destReg);
+                c.indice(er.instrucao, instrucoes, numInstrucoes);
+                c.indice(er.status, pool, tamanhoPool);
+                c.campo(er.entradaROB); c.campo(er.ciclosRestantes);
+            }
+        }
+        for (int r = 0; r < numTotalRegistradores; r++) {
+            c.secao();
+            c.campo(estadoRegistradores[r].unidadeEscritora);
+            c.campo(estadoRegistradores[r].entradaROB);
+            if (!c.soNucleo) c.campo(registradores[r].valor);
+        }
+
+        if (!c.soNucleo) {
+            // Memória: só as células escritas (as demais vêm do arquivo de entrada)
+            vector<pair<int, int>> celulas;
+            if (c.gravando) celulas = memoria.celulasTocadas();
+            size_t numCelulas = c.tamanho(celulas.size());
+            if (!c.gravando) celulas.resize(numCelulas);
+            for (pair<int, int>& cel : celulas) {
+                c.campo(cel.first);
+                c.campo(cel.second);
+            }
+            if (!c.gravando && c.erro.empty()) memoria.restaurarTocadas(celulas);
+
+            for (int i = 0; i < numInstrucoes; i++) c.campo(statusInstrucoes[i]);
+        }
+        c.secao();
+        c.lista(instancias.anel);
+        c.lista(instancias.emUso);
+        c.campo(instancias.cursor);
+        c.campo(instancias.ocupadas);
+        c.campo(retiradas);
+        if (instancias.anel.size() != (size_t)tamanhoPool || instancias.emUso.size() != (size_t)tamanhoPool) {
+            if (c.erro.empty()) c.erro = "pool de instancias com tamanho diferente";
+            return;
+        }
+
+        c.secao();
+        c.indicesPorOrdem(filaLS.storesProntos, buffersArmazenamento, numBuffersArmazenamento);
+        c.indicesPorEndereco(filaLS.storesPorEndereco, buffersArmazenamento, numBuffersArmazenamento);
+        c.indicesPorOrdem(filaLS.storesSemEndereco, buffersArmazenamento, numBuffersArmazenamento);
+        c.indicesPorEndereco(filaLS.loadsPorEndereco, buffersCarregamento, numBuffersCarregamento);
+        c.indicesPorOrdem(filaLS.loadsSemEndereco, buffersCarregamento, numBuffersCarregamento);
+        if (!c.soNucleo) c.lista(preditorMem.ssit);
+
+        c.secao();
+        for (Cache& n : caches.niveis) {
+            if (!c.soNucleo) c.lista(n.linhas);
+            c.campo(n.relogio); c.campo(n.sorteio); c.campo(n.acessos); c.campo(n.acertos);
+            c.campo(n.writebacks); c.campo(n.usosPrefetch); c.campo(n.prefetchsDespejados);
+            c.campo(n.acertouPrefetch);
+        }
+        c.ordenado(caches.usoPortas);
+        c.lista(caches.mshrs);
+        c.lista(caches.bancoLivre);
+        c.campo(caches.acessosMemoria); c.campo(caches.escritasMemoria);
+        c.campo(caches.esperasPorta); c.campo(caches.ciclosEsperaPorta);
+        c.campo(caches.fusoesMSHR); c.campo(caches.esperasMSHR); c.campo(caches.ciclosEsperaMSHR);
+        c.campo(caches.conflitosBanco); c.campo(caches.ciclosConflitoBanco);
+        c.campo(caches.picoMSHRs); c.campo(caches.falhasDemanda);
+        Prefetcher& pf = caches.prefetcher;
+        if (!c.soNucleo) c.lista(pf.tabela);
+        size_t numStreams = c.tamanho(pf.streams.size());
+        if (!c.gravando) pf.streams.resize(numStreams);
+        for (Prefetcher::BufferStream& sb : pf.streams) {
+            size_t n = c.tamanho(sb.linhas.size());
+            if (!c.gravando) sb.linhas.resize(n);
+            for (auto& l : sb.linhas) {
+                c.campo(l.first);
+                c.campo(l.second);
+            }
+            c.campo(sb.proximo);
+            c.campo(sb.uso);
+        }
+        c.campo(pf.relogio); c.campo(pf.emitidos); c.campo(pf.usosStream); c.campo(pf.atrasados);
+        c.campo(pf.descartadosStream); c.campo(pf.semMSHR);
+        c.campo(loadsIniciados); c.campo(somaLatenciaLoads); c.campo(loadsEspeculativos);
+        c.campo(violacoesMemoria); c.campo(instrucoesReexecutadas);
+
+        c.secao();
+        for (GrupoUnidades& g : unidades) {
+            c.lista(g.livreEm);
+            c.campo(g.operacoes); c.campo(g.ciclosOcupados); c.campo(g.esperas);
+        }
+        c.campo(limiteOrdemFU);
+        c.campo(cdb_rr); c.campo(totalEsperaCDB); c.campo(maiorEsperaCDB); c.campo(escritasCDB);
+
+        c.secao();
+        c.lista(filaInstrucoes);
+        c.campo(proxBusca); c.campo(buscaBloqueada); c.campo(contadorEmissao);
+        c.campo(slotsSemUso);
+        c.lista(slotsSemUsoPorEmitidas);
+        c.campo(pilhaCPI);
+        c.campo(pilhaCPIPorClasse);
+        c.lista(ciclosPorUnidade);
+        c.campo(instrucoesConcluidas);
+        c.campo(branchPending); c.campo(branchResolved); c.campo(branchTaken);
+        c.campo(branchTarget); c.campo(branchIssuedIndex);
+
+        for (int e = 0; e < tamanhoROB; e++) {
+            EntradaROB& x = rob[e];
+            c.secao();
+            c.campo(x.ocupado); c.campo(x.indiceInstrucao); c.campo(x.destReg); c.campo(x.pronto);
+            c.campo(x.valor); c.campo(x.unidade);
+            // A estação é gravada pela tag, que distingue ADD/SUB de MUL/DIV
+            int tagER = x.er ? x.er->id : SEM_UNIDADE;
+            c.campo(tagER);
+            if (!c.gravando) x.er = estacaoPorTag(tagER);
+            c.indice(x.lb, buffersCarregamento, numBuffersCarregamento);
+            c.indice(x.sb, buffersArmazenamento, numBuffersArmazenamento);
+            c.campo(x.previstoTomado); c.campo(x.historico); c.campo(x.leuMemoria);
+            c.campo(x.enderecoLido); c.campo(x.ordemFonte);
+            c.indice(x.status, pool, tamanhoPool);
+        }
+        c.secao();
+        c.campo(robCabeca); c.campo(robCauda); c.campo(robOcupadas);
+        if (!c.soNucleo) c.lista(preditor.contadores);
+        c.campo(preditor.historico);
+        c.campo(desviosResolvidos); c.campo(desviosErrados);
+        c.campo(instrucoesDescartadas); c.campo(ciclosPenalidade);
+
+        // Consumidores aguardando cada tag: refeitos a partir dos campos Q
+        if (!c.gravando) {
+            for (vector<Dependente>& d : dependentes) d.clear();
+            auto aguardar = [&](int& origem, int& valor, BufferLoad* lb = nullptr, BufferStore* sb = nullptr) {
+                if (origem != SEM_UNIDADE) dependentes[origem].push_back({ &origem, &valor, lb, sb });
+            };
+            for (int i = 0; i < numBuffersCarregamento; i++) {
+                BufferLoad& lb = buffersCarregamento[i];
+                if (lb.ocupado) aguardar(lb.origemBase, lb.baseVal, &lb);
+            }
+            for (int i = 0; i < numBuffersArmazenamento; i++) {
+                BufferStore& sb = buffersArmazenamento[i];
+                if (!sb.ocupado) continue;
+                aguardar(sb.origemBase, sb.baseVal, nullptr, &sb);
+                aguardar(sb.origemVal, sb.value);
+            }
+            for (int g = 0; g < 2; g++) {
+                EstacaoReserva* ers = g == 0 ? estacoesAddSub : estacoesMultDiv;
+                int n = g == 0 ? numEstacoesAddSub : numEstacoesMultDiv;
+                for (int i = 0; i < n; i++) {
+                    if (!ers[i].ocupado) continue;
+                    aguardar(ers[i].origemJ, ers[i].valorJ);
+                    aguardar(ers[i].origemK, ers[i].valorK);
+                }
+            }
+        }
+    }
+
+    EstacaoReserva* estacaoPorTag(int tag) {
+        for (int i = 0; i < numEstacoesAddSub; i++)
+            if (estacoesAddSub[i].id == tag) return &estacoesAddSub[i];
+        for (int i = 0; i < numEstacoesMultDiv; i++)
+            if (estacoesMultDiv[i].id == tag) return &estacoesMultDiv[i];
+        return nullptr;
+    }
+
+    void gravarCheckpoint(const string& nomeArquivo) {
+        Checkpoint c;
+        c.dados.append(ASSINATURA_CHECKPOINT, sizeof(ASSINATURA_CHECKPOINT));
+        uint32_t versao = VERSAO_CHECKPOINT;
+        c.campo(versao);
+        transferirEstado(c);
+        ofstream saida(nomeArquivo, ios::binary);
+        saida.write(c.dados.data(), (streamsize)c.dados.size());
+        if (!saida) {
+            cout << "Erro ao gravar checkpoint em " << nomeArquivo << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    // Restaura sobre a configuração e o programa já carregados do arquivo de entrada
+    void restaurarCheckpoint(const string& nomeArquivo) {
+        ifstream leitura(nomeArquivo, ios::binary);
+        if (!leitura.is_open()) {
+            cout << "O checkpoint nao pode ser aberto: " << nomeArquivo << endl;
+            exit(EXIT_FAILURE);
+        }
+        Checkpoint c;
+        c.gravando = false;
+        c.dados.assign(istreambuf_iterator<char>(leitura), istreambuf_iterator<char>());
+        char assinatura[sizeof(ASSINATURA_CHECKPOINT)];
+        c.bytes(assinatura, sizeof(assinatura));
+        uint32_t versao = 0;
+        c.campo(versao);
+        if (!c.erro.empty() || memcmp(assinatura, ASSINATURA_CHECKPOINT, sizeof(assinatura)) != 0)
+            c.erro = "assinatura invalida";
+        else if (versao != VERSAO_CHECKPOINT)
+            c.erro = "versao " + to_string(versao) + " nao suportada";
+        else
+            transferirEstado(c);
+        if (c.erro.empty() && c.pos != c.dados.size()) c.erro = "dados a mais no fim do arquivo";
+        if (!c.erro.empty()) {
+            cout << "Erro ao restaurar checkpoint " << nomeArquivo << ": " << c.erro << endl;
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    int encontrarBufferLoadLivre() {
+        for (int i = 0; i < numBuffersCarregamento; i++)
+            if (!buffersCarregamento[i].ocupado) return i;
+        return -1;
+    }
+
+    int encontrarBufferStoreLivre() {
+        for (int i = 0; i < numBuffersArmazenamento; i++)
+            if (!buffersArmazenamento[i].ocupado) return i;
+        return -1;
+    }
+
+    int encontrarERAddSubLivre() {
+        for (int i = 0; i < numEstacoesAddSub; i++)
+            if (!estacoesAddSub[i].ocupado) return i;
+        return -1;
     }
 
     int encontrarERMultDivLivre() {
@@ -420,50 +3033,36 @@ struct Tomasulo {
         return -1;
     }
 
-    void transmitirResultado(int valor, const string& nomeUnidade) {
+    // Broadcast no CDB: so visita os consumidores registrados para a tag
+    void transmitirResultado(int valor, int tag) {
+        for (const Dependente& d : dependentes[tag]) {
+            if (*d.origem != tag) continue;
+            *d.origem = SEM_UNIDADE;
+            *d.valor = valor;
+            if (d.baseLoad) filaLS.loadsComBase.push_back(d.baseLoad);
+            else if (d.baseStore) filaLS.storesComBase.push_back(d.baseStore);
+            if (d.baseLoad || d.baseStore || d.dadoStore) filaLS.loadsDesatualizados = true;
+        }
+        dependentes[tag].clear();
+    }
+
+    // LOAD bloqueado por STORE mais antigo (endereço desconhecido, ou mesmo
+    // endereço com valor pendente); senão, marca forwarding do STORE mais novo
+    // entre os mais antigos do mesmo endereço. Só percorre os aliases reais.
+    // O resultado fica em esperaStore: só muda quando chega uma base ou um dado
+    // de STORE, um STORE sai ou o preditor aprende (ver atualizarLoads).
+    void avaliarLoad(BufferLoad& loadBuf) {
+        loadBuf.esperaStore = checarHazardLoadEForward(loadBuf);
+    }
+
+    // Reavalia os LOADs que ainda não têm resultado se algo que avaliarLoad
+    // consulta mudou desde a última vez; chamado antes da execução do ciclo
+    void atualizarLoads() {
+        if (!filaLS.loadsDesatualizados) return;
+        filaLS.loadsDesatualizados = false;
         for (int i = 0; i < numBuffersCarregamento; i++) {
             BufferLoad& lb = buffersCarregamento[i];
-            if (!lb.ocupado) continue;
-            if (lb.origemBase == nomeUnidade) {
-                lb.origemBase.clear();
-                lb.baseVal = valor;
-            }
-        }
-        for (int i = 0; i < numBuffersArmazenamento; i++) {
-            BufferStore& sb = buffersArmazenamento[i];
-            if (!sb.ocupado) continue;
-            if (sb.origemBase == nomeUnidade) {
-                sb.origemBase.clear();
-                sb.baseVal = valor;
-            }
-            if (sb.origemVal == nomeUnidade) {
-                sb.origemVal.clear();
-                sb.value = valor;
-            }
-        }
-        for (int i = 0; i < numEstacoesAddSub; i++) {
-            EstacaoReserva& er = estacoesAddSub[i];
-            if (!er.ocupado) continue;
-            if (er.origemJ == nomeUnidade) {
-                er.origemJ.clear();
-                er.valorJ = valor;
-            }
-            if (er.origemK == nomeUnidade) {
-                er.origemK.clear();
-                er.valorK = valor;
-            }
-        }
-        for (int i = 0; i < numEstacoesMultDiv; i++) {
-            EstacaoReserva& er = estacoesMultDiv[i];
-            if (!er.ocupado) continue;
-            if (er.origemJ == nomeUnidade) {
-                er.origemJ.clear();
-                er.valorJ = valor;
-            }
-            if (er.origemK == nomeUnidade) {
-                er.origemK.clear();
-                er.valorK = valor;
-            }
+            if (lb.ocupado && lb.instrucao && !lb.resultReady) avaliarLoad(lb);
         }
     }
 
@@ -471,258 +3070,482 @@ struct Tomasulo {
         loadBuf.hasForward = false;
         loadBuf.forwardVal = 0;
 
-        if (!loadBuf.origemBase.empty()) return true;
+        if (loadBuf.origemBase != SEM_UNIDADE) return true;
+
+        long long emitLd = loadBuf.status->sequencia;
+        loadBuf.especulativo = false;
+        if (preditorMem.ativo) {
+            // Só espera os STOREs sem endereço previstos como dependentes
+            int pcLd = (int)(loadBuf.instrucao - instrucoes);
+            for (const auto& e : filaLS.storesSemEndereco) {
+                if (e.first > emitLd) break;
+                BufferStore* st = e.second;
+                if (preditorMem.dependente(pcLd, (int)(st->instrucao - instrucoes))) return true;
+                loadBuf.especulativo = true;
+            }
+        } else if (filaLS.haStoreAntigoSemEndereco(emitLd)) {
+            return true;
+        }
 
         int loadAddr = loadBuf.baseVal + loadBuf.instrucao->offsetImediato;
+        loadBuf.ordemFonte = -1;
+        auto pos = filaLS.storesPorEndereco.find(loadAddr);
+        if (pos == filaLS.storesPorEndereco.end()) return false;
 
-        bool existeStoreAntigoMesmoEndNaoPronto = false;
-        int melhorEmit = -1;
+        long long melhorEmit = -1;
         int melhorVal = 0;
-
-        for (int i = 0; i < numBuffersArmazenamento; ++i) {
-            BufferStore& st = buffersArmazenamento[i];
-            if (!st.ocupado || !st.instrucao) continue;
-
-            int emitSt = st.instrucao->status.emitido;
-            int emitLd = loadBuf.instrucao->status.emitido;
-            if (emitSt == -1 || emitSt > emitLd) continue;
-
-            if (!st.origemBase.empty()) {
-                existeStoreAntigoMesmoEndNaoPronto = true;
-                continue;
-            }
-
-            int stAddr = st.baseVal + st.instrucao->offsetImediato;
-            if (stAddr == loadAddr) {
-                if (st.origemVal.empty()) {
-                    if (emitSt > melhorEmit) {
-                        melhorEmit = emitSt;
-                        melhorVal = st.value;
-                    }
-                } else {
-                    existeStoreAntigoMesmoEndNaoPronto = true;
-                }
+        for (BufferStore* st : pos->second) {
+            long long emitSt = st->status->sequencia;
+            if (emitSt > emitLd) continue;
+            if (st->origemVal != SEM_UNIDADE) return true;
+            if (emitSt > melhorEmit) {
+                melhorEmit = emitSt;
+                melhorVal = st->value;
             }
         }
 
-        if (existeStoreAntigoMesmoEndNaoPronto) return true;
         if (melhorEmit != -1) {
             loadBuf.hasForward = true;
             loadBuf.forwardVal = melhorVal;
         }
+        loadBuf.ordemFonte = melhorEmit;
         return false;
     }
 
-    int emitirInstrucao(int indiceInstrucao) {
+    // Abre o registro da instância emitida, tirado do pool, com o próximo
+    // número de sequência. Duas instâncias da mesma instrução podem estar em voo
+    // ao mesmo tempo (laços), então o status da instrução só recebe a cópia
+    // quando a instância é retirada.
+    StatusInstrucao* iniciarRegistro(int latencia) {
+        StatusInstrucao* st = instancias.alocar();
+        st->emitido = cicloAtual;
+        st->sequencia = contadorEmissao++;
+        st->ciclosRestantesExecucao = latencia;
+        if (tamanhoROB > 0) rob[robCauda].status = st;
+        return st;
+    }
+
+    // Instância concluída: vira estatística e devolve o registro ao pool
+    void retirarInstancia(const Instrucao& instr, StatusInstrucao* st) {
+        publicarRegistro(instr, *st);
+        retiradas.registrar(*st);
+        if (classeConcluida == -1) classeConcluida = classeInstrucao(instr.tipoInstrucao);
+        instancias.liberar(st);
+    }
+
+    // Ocupa a entrada da cauda do ROB para a instrução recém-emitida
+    int alocarROB(const InstrucaoBuscada& busca, int unidade,
+                  EstacaoReserva* er, BufferLoad* lb, BufferStore* sb) {
+        if (tamanhoROB == 0) return -1;
+        int e = robCauda;
+        EntradaROB& ent = rob[e];
+        ent.ocupado = true;
+        ent.indiceInstrucao = busca.indice;
+        ent.destReg = -1;
+        ent.pronto = false;
+        ent.valor = 0;
+        ent.unidade = unidade;
+        ent.er = er;
+        ent.lb = lb;
+        ent.sb = sb;
+        ent.previstoTomado = busca.previstoTomado;
+        ent.historico = busca.historico;
+        ent.leuMemoria = false;
+        robCauda = (robCauda + 1) % tamanhoROB;
+        robOcupadas++;
+        return e;
+    }
+
+    int emitirInstrucao(const InstrucaoBuscada& busca) {
+        int indiceInstrucao = busca.indice;
         if (indiceInstrucao >= numInstrucoes) return -2;
         if (branchPending) return -1;
+        if (tamanhoROB > 0 && robOcupadas == tamanhoROB) {
+            if (!modoBatch) logEventos += "-> Instrucao " + to_string(indiceInstrucao) +
+                                          " nao emitida (ROB cheio).\n";
+            return -1;
+        }
 
-        Instrucao& instr = instrucoes[indiceInstrucao];
+        const Instrucao& instr = instrucoes[indiceInstrucao];
+        uint8_t op = operacaoBase(instr.tipoInstrucao);
 
         if (instr.tipoInstrucao == TiposInstrucao::CARREGA) {
             int idx = encontrarBufferLoadLivre();
             if (idx == -1) {
-                logEventos += "-> Instrucao " + to_string(indiceInstrucao) +
-                              " nao emitida (sem Buffer LOAD).\n";
+                if (!modoBatch) logEventos += "-> Instrucao " + to_string(indiceInstrucao) +
+                                              " nao emitida (sem Buffer LOAD).\n";
                 return -1;
             }
             BufferLoad& lb = buffersCarregamento[idx];
             lb.ocupado = true;
             lb.instrucao = &instr;
-            instr.status.emitido = cicloAtual;
-            instr.status.ciclosRestantesExecucao = ciclosLS;
+            lb.status = iniciarRegistro(ciclosLS);
+            lb.entradaROB = alocarROB(busca, lb.id, nullptr, &lb, nullptr);
             lb.ciclosRestantes = ciclosLS;
+            lb.latencia = ciclosLS;
+            lb.fimEspera = -1;
 
-            int rsIdx = regIndex(instr.regFonte1);
-            if (rsIdx < 0) throw runtime_error("Registrador invalido: " + instr.regFonte1);
-            lb.origemBase = estadoRegistradores[rsIdx].unidadeEscritora;
-            if (lb.origemBase.empty())
-                lb.baseVal = obterValorRegistrador(instr.regFonte1);
+            int rsIdx = instr.regFonte1;
+            lerOperando(rsIdx, lb.origemBase, lb.baseVal, &lb);
             lb.offset = instr.offsetImediato;
+            filaLS.inserir(&lb);
 
-            int rdIdx = regIndex(instr.regFonte2);
-            if (rdIdx < 0) throw runtime_error("Registrador invalido: " + instr.regFonte2);
+            int rdIdx = instr.regFonte2;
             lb.destReg = rdIdx;
-            estadoRegistradores[rdIdx].unidadeEscritora = lb.nome;
+            definirEscritor(rdIdx, lb.id, lb.entradaROB);
+            if (lb.entradaROB >= 0) rob[lb.entradaROB].destReg = rdIdx;
 
             lb.resultReady = false;
-            lb.hasForward = false;
-            lb.forwardVal = 0;
+            avaliarLoad(lb);
 
-            logEventos += "-> Instrucao " + to_string(indiceInstrucao) +
-                          " emitida para " + lb.nome + " (LOAD).\n";
+            if (!modoBatch) logEventos += "-> Instrucao " + to_string(indiceInstrucao) +
+                                          " emitida para " + lb.nome + " (LOAD).\n";
             return 0;
         } else if (instr.tipoInstrucao == TiposInstrucao::ARMAZENA) {
             int idx = encontrarBufferStoreLivre();
             if (idx == -1) {
-                logEventos += "-> Instrucao " + to_string(indiceInstrucao) +
-                              " nao emitida (sem Buffer STORE).\n";
+                if (!modoBatch) logEventos += "-> Instrucao " + to_string(indiceInstrucao) +
+                                              " nao emitida (sem Buffer STORE).\n";
                 return -1;
             }
             BufferStore& sb = buffersArmazenamento[idx];
             sb.ocupado = true;
             sb.instrucao = &instr;
-            instr.status.emitido = cicloAtual;
-            instr.status.ciclosRestantesExecucao = ciclosLS;
+            sb.status = iniciarRegistro(ciclosLS);
+            sb.entradaROB = alocarROB(busca, sb.id, nullptr, nullptr, &sb);
             sb.ciclosRestantes = ciclosLS;
+            sb.fimEspera = -1;
 
-            int rsIdx = regIndex(instr.regFonte1);
-            if (rsIdx < 0) throw runtime_error("Registrador invalido: " + instr.regFonte1);
-            sb.origemBase = estadoRegistradores[rsIdx].unidadeEscritora;
-            if (sb.origemBase.empty())
-                sb.baseVal = obterValorRegistrador(instr.regFonte1);
+            int rsIdx = instr.regFonte1;
+            lerOperando(rsIdx, sb.origemBase, sb.baseVal, nullptr, &sb);
             sb.offset = instr.offsetImediato;
 
-            int rtIdx = regIndex(instr.regFonte2);
-            if (rtIdx < 0) throw runtime_error("Registrador invalido: " + instr.regFonte2);
-            sb.origemVal = estadoRegistradores[rtIdx].unidadeEscritora;
-            if (sb.origemVal.empty())
-                sb.value = obterValorRegistrador(instr.regFonte2);
+            int rtIdx = instr.regFonte2;
+            lerOperando(rtIdx, sb.origemVal, sb.value, nullptr, nullptr, true);
+            filaLS.inserir(&sb);
 
-            logEventos += "-> Instrucao " + to_string(indiceInstrucao) +
-                          " emitida para " + sb.nome + " (STORE).\n";
+            if (!modoBatch) logEventos += "-> Instrucao " + to_string(indiceInstrucao) +
+                                          " emitida para " + sb.nome + " (STORE).\n";
             return 0;
-        } else if (instr.tipoInstrucao == TiposInstrucao::SOMA ||
-                   instr.tipoInstrucao == TiposInstrucao::SUBT) {
+        } else if (op == TiposInstrucao::SOMA || op == TiposInstrucao::SUBT) {
             int idx = encontrarERAddSubLivre();
             if (idx == -1) {
-                logEventos += "-> Instrucao " + to_string(indiceInstrucao) +
-                              " nao emitida (sem ER ADD/SUB).\n";
+                if (!modoBatch) logEventos += "-> Instrucao " + to_string(indiceInstrucao) +
+                                              " nao emitida (sem ER ADD/SUB).\n";
                 return -1;
             }
             EstacaoReserva& er = estacoesAddSub[idx];
             er.ocupado = true;
-            er.tipoInstrucao = instr.tipoInstrucao;
+            er.tipoInstrucao = op;
             er.instrucao = &instr;
-            instr.status.emitido = cicloAtual;
-            instr.status.ciclosRestantesExecucao = ciclosAddSub;
+            er.status = iniciarRegistro(ciclosAddSub);
+            er.entradaROB = alocarROB(busca, er.id, &er, nullptr, nullptr);
             er.ciclosRestantes = ciclosAddSub;
 
-            int rsIdx = regIndex(instr.regFonte1);
-            if (rsIdx < 0) throw runtime_error("Registrador invalido: " + instr.regFonte1);
-            er.origemJ = estadoRegistradores[rsIdx].unidadeEscritora;
-            if (er.origemJ.empty())
-                er.valorJ = obterValorRegistrador(instr.regFonte1);
+            int rsIdx = instr.regFonte1;
+            lerOperando(rsIdx, er.origemJ, er.valorJ);
 
-            int rtIdx = regIndex(instr.regFonte2);
-            if (rtIdx < 0) throw runtime_error("Registrador invalido: " + instr.regFonte2);
-            er.origemK = estadoRegistradores[rtIdx].unidadeEscritora;
-            if (er.origemK.empty())
-                er.valorK = obterValorRegistrador(instr.regFonte2);
+            lerSegundoOperando(instr, er);
 
-            int rdIdx = regIndex(instr.regDestino);
-            if (rdIdx < 0) throw runtime_error("Registrador invalido: " + instr.regDestino);
+            int rdIdx = instr.regDestino;
             er.destReg = rdIdx;
-            estadoRegistradores[rdIdx].unidadeEscritora = er.nome;
+            definirEscritor(rdIdx, er.id, er.entradaROB);
+            if (er.entradaROB >= 0) rob[er.entradaROB].destReg = rdIdx;
 
-            logEventos += "-> Instrucao " + to_string(indiceInstrucao) +
-                          " emitida para " + er.nome + " (ADD/SUB).\n";
+            if (!modoBatch) logEventos += "-> Instrucao " + to_string(indiceInstrucao) +
+                                          " emitida para " + er.nome + " (ADD/SUB).\n";
             return 0;
-        } else if (instr.tipoInstrucao == TiposInstrucao::MULT ||
-                   instr.tipoInstrucao == TiposInstrucao::DIVI) {
+        } else if (op == TiposInstrucao::MULT || op == TiposInstrucao::DIVI) {
             int idx = encontrarERMultDivLivre();
             if (idx == -1) {
-                logEventos += "-> Instrucao " + to_string(indiceInstrucao) +
-                              " nao emitida (sem ER MUL/DIV).\n";
+                if (!modoBatch) logEventos += "-> Instrucao " + to_string(indiceInstrucao) +
+                                              " nao emitida (sem ER MUL/DIV).\n";
                 return -1;
             }
             EstacaoReserva& er = estacoesMultDiv[idx];
             er.ocupado = true;
-            er.tipoInstrucao = instr.tipoInstrucao;
+            er.tipoInstrucao = op;
             er.instrucao = &instr;
-            instr.status.emitido = cicloAtual;
-            int lat = (instr.tipoInstrucao == TiposInstrucao::MULT) ? ciclosMult : ciclosDiv;
-            instr.status.ciclosRestantesExecucao = lat;
+            int lat = (op == TiposInstrucao::MULT) ? ciclosMult : ciclosDiv;
+            er.status = iniciarRegistro(lat);
+            er.entradaROB = alocarROB(busca, er.id, &er, nullptr, nullptr);
             er.ciclosRestantes = lat;
 
-            int rsIdx = regIndex(instr.regFonte1);
-            if (rsIdx < 0) throw runtime_error("Registrador invalido: " + instr.regFonte1);
-            er.origemJ = estadoRegistradores[rsIdx].unidadeEscritora;
-            if (er.origemJ.empty())
-                er.valorJ = obterValorRegistrador(instr.regFonte1);
+            int rsIdx = instr.regFonte1;
+            lerOperando(rsIdx, er.origemJ, er.valorJ);
 
-            int rtIdx = regIndex(instr.regFonte2);
-            if (rtIdx < 0) throw runtime_error("Registrador invalido: " + instr.regFonte2);
-            er.origemK = estadoRegistradores[rtIdx].unidadeEscritora;
-            if (er.origemK.empty())
-                er.valorK = obterValorRegistrador(instr.regFonte2);
+            lerSegundoOperando(instr, er);
 
-            int rdIdx = regIndex(instr.regDestino);
-            if (rdIdx < 0) throw runtime_error("Registrador invalido: " + instr.regDestino);
+            int rdIdx = instr.regDestino;
             er.destReg = rdIdx;
-            estadoRegistradores[rdIdx].unidadeEscritora = er.nome;
+            definirEscritor(rdIdx, er.id, er.entradaROB);
+            if (er.entradaROB >= 0) rob[er.entradaROB].destReg = rdIdx;
 
-            logEventos += "-> Instrucao " + to_string(indiceInstrucao) +
-                          " emitida para " + er.nome + " (MUL/DIV).\n";
+            if (!modoBatch) logEventos += "-> Instrucao " + to_string(indiceInstrucao) +
+                                          " emitida para " + er.nome + " (MUL/DIV).\n";
             return 0;
-        } else if (instr.tipoInstrucao == TiposInstrucao::BNE) {
+        } else if (ehDesvio(instr.tipoInstrucao)) {
             int idx = encontrarERAddSubLivre();
             if (idx == -1) {
-                logEventos += "-> Instrucao " + to_string(indiceInstrucao) +
-                              " nao emitida (sem ER BNE).\n";
+                if (!modoBatch) logEventos += "-> Instrucao " + to_string(indiceInstrucao) +
+                                              " nao emitida (sem ER " +
+                                              NOMES_TIPOS_INSTRUCAO[instr.tipoInstrucao] + ").\n";
                 return -1;
             }
             EstacaoReserva& er = estacoesAddSub[idx];
             er.ocupado = true;
-            er.tipoInstrucao = TiposInstrucao::BNE;
+            er.tipoInstrucao = instr.tipoInstrucao;
             er.instrucao = &instr;
-            instr.status.emitido = cicloAtual;
-            instr.status.ciclosRestantesExecucao = 1;
+            er.status = iniciarRegistro(1);
+            er.entradaROB = alocarROB(busca, er.id, &er, nullptr, nullptr);
             er.ciclosRestantes = 1;
             er.destReg = -1;
 
-            int rsIdx = regIndex(instr.regFonte1);
-            if (rsIdx < 0) throw runtime_error("Registrador invalido: " + instr.regFonte1);
-            er.origemJ = estadoRegistradores[rsIdx].unidadeEscritora;
-            if (er.origemJ.empty())
-                er.valorJ = obterValorRegistrador(instr.regFonte1);
+            int rsIdx = instr.regFonte1;
+            lerOperando(rsIdx, er.origemJ, er.valorJ);
 
-            int rtIdx = regIndex(instr.regFonte2);
-            if (rtIdx < 0) throw runtime_error("Registrador invalido: " + instr.regFonte2);
-            er.origemK = estadoRegistradores[rtIdx].unidadeEscritora;
-            if (er.origemK.empty())
-                er.valorK = obterValorRegistrador(instr.regFonte2);
+            int rtIdx = instr.regFonte2;
+            lerOperando(rtIdx, er.origemK, er.valorK);
 
-            branchPending = true;
-            branchResolved = false;
-            branchIssuedIndex = indiceInstrucao;
+            if (tamanhoROB == 0) {
+                branchPending = true;
+                branchResolved = false;
+                branchIssuedIndex = indiceInstrucao;
+            }
 
-            logEventos += "-> Instrucao " + to_string(indiceInstrucao) +
-                          " emitida para " + er.nome + " (BNE).\n";
+            if (!modoBatch) logEventos += "-> Instrucao " + to_string(indiceInstrucao) +
+                                          " emitida para " + er.nome + " (" +
+                                          NOMES_TIPOS_INSTRUCAO[instr.tipoInstrucao] + ").\n";
+            return 0;
+        } else if (instr.tipoInstrucao == TiposInstrucao::NOP) {
+            // Não ocupa estação: conclui na emissão (com ROB, ainda sai em ordem no commit)
+            StatusInstrucao* st = iniciarRegistro(0);
+            st->escritaResultado = cicloAtual;
+            int e = alocarROB(busca, SEM_UNIDADE, nullptr, nullptr, nullptr);
+            if (e >= 0) {
+                rob[e].pronto = true;
+            } else {
+                retirarInstancia(instr, st);
+                instrucoesConcluidas++;
+            }
+            if (!modoBatch) logEventos += "-> Instrucao " + to_string(indiceInstrucao) + " emitida (NOP).\n";
             return 0;
         }
 
         return 0;
     }
 
+    // Operando K: registrador Rt, ou o imediato já pronto nas formas ADDI etc.
+    void lerSegundoOperando(const Instrucao& instr, EstacaoReserva& er) {
+        if (ehImediato(instr.tipoInstrucao)) {
+            er.origemK = SEM_UNIDADE;
+            er.valorK = instr.offsetImediato;
+        } else {
+            lerOperando(instr.regFonte2, er.origemK, er.valorK);
+        }
+    }
+
+    // Motivo pelo qual a cabeça da fila não pode ser emitida agora (-1 se pode)
+    int motivoEmissaoBloqueada() {
+        if (branchPending) return SLOT_BRANCH;
+        if (filaInstrucoes.empty())
+            return buscaBloqueada ? SLOT_BRANCH : SLOT_FILA_VAZIA;
+        if (tamanhoROB > 0 && robOcupadas == tamanhoROB) return SLOT_SEM_ROB;
+        uint8_t tipo = operacaoBase(instrucoes[filaInstrucoes.front().indice].tipoInstrucao);
+        if (tipo == TiposInstrucao::CARREGA)
+            return encontrarBufferLoadLivre() == -1 ? SLOT_SEM_BUFFER_LOAD : -1;
+        if (tipo == TiposInstrucao::ARMAZENA)
+            return encontrarBufferStoreLivre() == -1 ? SLOT_SEM_BUFFER_STORE : -1;
+        if (tipo == TiposInstrucao::SOMA || tipo == TiposInstrucao::SUBT || ehDesvio(tipo))
+            return encontrarERAddSubLivre() == -1 ? SLOT_SEM_ER_ADD_SUB : -1;
+        if (tipo == TiposInstrucao::MULT || tipo == TiposInstrucao::DIVI)
+            return encontrarERMultDivLivre() == -1 ? SLOT_SEM_ER_MUL_DIV : -1;
+        return -1;
+    }
+
+    int alvoDesvio(int indiceDesvio) const {
+        int alvo = indiceDesvio + 1 + instrucoes[indiceDesvio].offsetImediato;
+        return min(max(alvo, 0), numInstrucoes);
+    }
+
+    // Busca em ordem até larguraEmissao instruções para a fila. Sem ROB a busca
+    // para após um BNE; com ROB segue o caminho previsto (um desvio previsto
+    // como tomado encerra o grupo de busca do ciclo).
+    void buscarInstrucoes() {
+        for (int k = 0; k < larguraEmissao; k++) {
+            if (buscaBloqueada || buscaSuspensa || proxBusca >= numInstrucoes) return;
+            if ((int)filaInstrucoes.size() >= tamanhoFilaInstrucoes) return;
+            InstrucaoBuscada b = { proxBusca, false, preditor.historico };
+            proxBusca++;
+            if (ehDesvio(instrucoes[b.indice].tipoInstrucao)) {
+                if (tamanhoROB == 0) {
+                    buscaBloqueada = true;
+                } else {
+                    b.previstoTomado = preditor.prever(b.indice);
+                    preditor.especular(b.previstoTomado);
+                    if (b.previstoTomado) proxBusca = alvoDesvio(b.indice);
+                }
+            }
+            filaInstrucoes.push_back(b);
+            if (b.previstoTomado) return;
+        }
+    }
+
+    // Emissão em ordem de até larguraEmissao instruções; para no primeiro bloqueio
+    void emitirCiclo() {
+        int emitidas = 0;
+        int motivo = -1;
+        while (emitidas < larguraEmissao) {
+            if (branchPending || filaInstrucoes.empty() ||
+                emitirInstrucao(filaInstrucoes.front()) == -1) {
+                motivo = motivoEmissaoBloqueada();
+                break;
+            }
+            filaInstrucoes.pop_front();
+            emitidas++;
+        }
+        registrarSlotsSemUso(emitidas, motivo, 1);
+        if (emitidas < larguraEmissao && larguraEmissao > 1)
+            if (!modoBatch) logEventos += "-> " + to_string(larguraEmissao - emitidas) +
+                                          " slot(s) de emissao sem uso (" + NOMES_MOTIVOS_SLOT[motivo] + ").\n";
+    }
+
+    void registrarSlotsSemUso(int emitidas, int motivo, long long ciclos) {
+        slotsSemUsoPorEmitidas[emitidas] += ciclos;
+        if (emitidas < larguraEmissao)
+            slotsSemUso[motivo] += (larguraEmissao - emitidas) * ciclos;
+    }
+
+    int intervaloIniciacao(uint8_t tipo) const {
+        if (tipo == TiposInstrucao::MULT) return intervaloMult;
+        if (tipo == TiposInstrucao::DIVI) return intervaloDiv;
+        if (ehDesvio(tipo)) return 1;
+        if (tipo == TiposInstrucao::CARREGA || tipo == TiposInstrucao::ARMAZENA) return intervaloLS;
+        return intervaloAddSub;
+    }
+
+    // Estações/buffers com operandos prontos que podem iniciar a execução no
+    // ciclo 'ciclo', por grupo de unidades: (ordem de emissão, status)
+    void prontosParaIniciar(int ciclo, vector<pair<long long, StatusInstrucao*>> prontos[NUM_GRUPOS_FU]) {
+        for (int i = 0; i < numBuffersCarregamento; i++) {
+            BufferLoad& lb = buffersCarregamento[i];
+            if (!lb.ocupado || !lb.instrucao || lb.status->inicioExecucao != -1) continue;
+            if (lb.status->emitido >= ciclo || lb.esperaStore) continue;
+            prontos[FU_LOAD_STORE].push_back({ lb.status->sequencia, lb.status });
+        }
+        for (int i = 0; i < numBuffersArmazenamento; i++) {
+            BufferStore& sb = buffersArmazenamento[i];
+            if (!sb.ocupado || !sb.instrucao || sb.status->inicioExecucao != -1) continue;
+            if (sb.status->emitido >= ciclo) continue;
+            if (sb.origemBase != SEM_UNIDADE || sb.origemVal != SEM_UNIDADE) continue;
+            prontos[FU_LOAD_STORE].push_back({ sb.status->sequencia, sb.status });
+        }
+        for (int g = FU_ADD_SUB; g <= FU_MUL_DIV; g++) {
+            EstacaoReserva* ers = g == FU_ADD_SUB ? estacoesAddSub : estacoesMultDiv;
+            int n = g == FU_ADD_SUB ? numEstacoesAddSub : numEstacoesMultDiv;
+            for (int i = 0; i < n; i++) {
+                EstacaoReserva& er = ers[i];
+                if (!er.ocupado || !er.instrucao || er.status->inicioExecucao != -1) continue;
+                if (er.status->emitido >= ciclo) continue;
+                if (er.origemJ != SEM_UNIDADE || er.origemK != SEM_UNIDADE) continue;
+                prontos[g].push_back({ er.status->sequencia, er.status });
+            }
+        }
+    }
+
+    // Distribui as unidades livres do ciclo às instruções prontas mais antigas:
+    // limiteOrdemFU guarda a ordem de emissão da mais nova atendida
+    void concederUnidades() {
+        vector<pair<long long, StatusInstrucao*>> prontos[NUM_GRUPOS_FU];
+        bool limitado = false;
+        for (int g = 0; g < NUM_GRUPOS_FU; g++) limitado |= unidades[g].quantidade > 0;
+        if (!limitado) return;
+        prontosParaIniciar(cicloAtual, prontos);
+        for (int g = 0; g < NUM_GRUPOS_FU; g++) {
+            GrupoUnidades& grupo = unidades[g];
+            if (grupo.quantidade == 0) continue;
+            sort(prontos[g].begin(), prontos[g].end(),
+                 [](const pair<long long, StatusInstrucao*>& a, const pair<long long, StatusInstrucao*>& b) {
+                     return a.first < b.first;
+                 });
+            int livres = min((int)prontos[g].size(), grupo.livresEm(cicloAtual));
+            limiteOrdemFU[g] = livres > 0 ? prontos[g][livres - 1].first : -1;
+            grupo.esperas += (long long)prontos[g].size() - livres;
+        }
+    }
+
+    // Ocupa uma unidade do grupo para a instrução que inicia a execução agora;
+    // falso se ela não foi atendida neste ciclo
+    bool reservarUnidade(int g, const StatusInstrucao& st, uint8_t tipo, const string& nome) {
+        GrupoUnidades& grupo = unidades[g];
+        if (grupo.quantidade == 0) return true;
+        if (st.sequencia > limiteOrdemFU[g]) {
+            if (!modoBatch) logEventos += "-> " + nome + " aguardando unidade funcional " + grupo.nome + ".\n";
+            return false;
+        }
+        int u = grupo.unidadeLivre(cicloAtual);
+        int intervalo = intervaloIniciacao(tipo);
+        grupo.livreEm[u] = cicloAtual + intervalo;
+        grupo.operacoes++;
+        grupo.ciclosOcupados += intervalo;
+        return true;
+    }
+
     void executar() {
+        atualizarLoads();
+        concederUnidades();
+
         for (int i = 0; i < numBuffersCarregamento; i++) {
             BufferLoad& lb = buffersCarregamento[i];
             if (!lb.ocupado || !lb.instrucao) continue;
 
-            if (checarHazardLoadEForward(lb)) continue;
-
-            if (lb.instrucao->status.inicioExecucao == -1) {
-                if (lb.instrucao->status.emitido == cicloAtual) continue;
-                lb.instrucao->status.inicioExecucao = cicloAtual;
-                logEventos += "-> " + lb.nome + " iniciou execucao (LOAD).\n";
+            if (lb.esperaStore) continue;
+
+            if (lb.status->inicioExecucao == -1) {
+                if (lb.status->emitido == cicloAtual) continue;
+                if (!reservarUnidade(FU_LOAD_STORE, *lb.status, TiposInstrucao::CARREGA, lb.nome)) continue;
+                lb.status->inicioExecucao = cicloAtual;
+                if (caches.modelada()) {
+                    // Forwarding de STORE custa um acerto em L1 e não ocupa porta;
+                    // o resto consulta a hierarquia
+                    int espera = 0;
+                    if (!lb.hasForward)
+                        lb.latencia = caches.acessar(lb.baseVal + lb.instrucao->offsetImediato, false,
+                                                     cicloAtual, espera, (int)(lb.instrucao - instrucoes));
+                    else if (caches.ativa())
+                        lb.latencia = caches.niveis[0].latencia;
+                    lb.fimEspera = cicloAtual + espera - 1;
+                    lb.ciclosRestantes = lb.status->ciclosRestantesExecucao = lb.latencia;
+                }
+                loadsIniciados++;
+                somaLatenciaLoads += lb.latencia;
+                if (!modoBatch) logEventos += "-> " + lb.nome + " iniciou execucao (LOAD, " +
+                                              to_string(lb.latencia) + " ciclos).\n";
             }
 
             if (lb.ciclosRestantes > 0) {
                 lb.ciclosRestantes--;
-                lb.instrucao->status.ciclosRestantesExecucao = lb.ciclosRestantes;
-                logEventos += "-> " + lb.nome + " completou 1 ciclo. Restantes: " +
-                              to_string(lb.ciclosRestantes) + ".\n";
+                lb.status->ciclosRestantesExecucao = lb.ciclosRestantes;
+                if (!modoBatch) logEventos += "-> " + lb.nome + " completou 1 ciclo. Restantes: " +
+                                              to_string(lb.ciclosRestantes) + ".\n";
                 if (lb.ciclosRestantes == 0) {
-                    lb.instrucao->status.fimExecucao = cicloAtual;
+                    lb.status->fimExecucao = cicloAtual;
                     lb.resultReady = true;
+                    filaLS.remover(&lb);
+                    if (lb.entradaROB >= 0) {
+                        EntradaROB& ent = rob[lb.entradaROB];
+                        ent.leuMemoria = true;
+                        ent.enderecoLido = lb.baseVal + lb.instrucao->offsetImediato;
+                        ent.ordemFonte = lb.ordemFonte;
+                    }
+                    if (lb.especulativo) loadsEspeculativos++;
                     if (lb.hasForward)
                         lb.resultado = lb.forwardVal;
                     else {
                         int addr = lb.baseVal + lb.instrucao->offsetImediato;
                         lb.resultado = lerMemoria(addr);
                     }
-                    logEventos += "-> " + lb.nome + " completou execucao.\n";
+                    if (!modoBatch) logEventos += "-> " + lb.nome + " completou execucao.\n";
                 }
             }
         }
@@ -730,23 +3553,33 @@ struct Tomasulo {
         for (int i = 0; i < numBuffersArmazenamento; i++) {
             BufferStore& sb = buffersArmazenamento[i];
             if (!sb.ocupado || !sb.instrucao) continue;
-            if (!sb.origemBase.empty()) continue;
-            if (!sb.origemVal.empty()) continue;
-
-            if (sb.instrucao->status.inicioExecucao == -1) {
-                if (sb.instrucao->status.emitido == cicloAtual) continue;
-                sb.instrucao->status.inicioExecucao = cicloAtual;
-                logEventos += "-> " + sb.nome + " iniciou execucao (STORE).\n";
+            if (sb.origemBase != SEM_UNIDADE) continue;
+            if (sb.origemVal != SEM_UNIDADE) continue;
+
+            if (sb.status->inicioExecucao == -1) {
+                if (sb.status->emitido == cicloAtual) continue;
+                if (!reservarUnidade(FU_LOAD_STORE, *sb.status, TiposInstrucao::ARMAZENA, sb.nome)) continue;
+                sb.status->inicioExecucao = cicloAtual;
+                if (caches.modelada()) {
+                    int espera;
+                    sb.ciclosRestantes = sb.status->ciclosRestantesExecucao =
+                        caches.acessar(sb.baseVal + sb.instrucao->offsetImediato, true, cicloAtual, espera);
+                    sb.fimEspera = cicloAtual + espera - 1;
+                }
+                if (!modoBatch) logEventos += "-> " + sb.nome + " iniciou execucao (STORE, " +
+                                              to_string(sb.ciclosRestantes) + " ciclos).\n";
             }
 
             if (sb.ciclosRestantes > 0) {
                 sb.ciclosRestantes--;
-                sb.instrucao->status.ciclosRestantesExecucao = sb.ciclosRestantes;
-                logEventos += "-> " + sb.nome + " completou 1 ciclo. Restantes: " +
-                              to_string(sb.ciclosRestantes) + ".\n";
+                sb.status->ciclosRestantesExecucao = sb.ciclosRestantes;
+                if (!modoBatch) logEventos += "-> " + sb.nome + " completou 1 ciclo. Restantes: " +
+                                              to_string(sb.ciclosRestantes) + ".\n";
                 if (sb.ciclosRestantes == 0) {
-                    sb.instrucao->status.fimExecucao = cicloAtual;
-                    logEventos += "-> " + sb.nome + " completou execucao.\n";
+                    sb.status->fimExecucao = cicloAtual;
+                    filaLS.pronto(&sb);
+                    if (sb.entradaROB >= 0) rob[sb.entradaROB].pronto = true;
+                    if (!modoBatch) logEventos += "-> " + sb.nome + " completou execucao.\n";
                 }
             }
         }
@@ -754,22 +3587,23 @@ struct Tomasulo {
         for (int i = 0; i < numEstacoesAddSub; i++) {
             EstacaoReserva& er = estacoesAddSub[i];
             if (!er.ocupado || !er.instrucao) continue;
-            if (!er.origemJ.empty() || !er.origemK.empty()) continue;
+            if (er.origemJ != SEM_UNIDADE || er.origemK != SEM_UNIDADE) continue;
 
-            if (er.instrucao->status.inicioExecucao == -1) {
-                if (er.instrucao->status.emitido == cicloAtual) continue;
-                er.instrucao->status.inicioExecucao = cicloAtual;
-                logEventos += "-> " + er.nome + " iniciou execucao (" + er.tipoInstrucao + ").\n";
+            if (er.status->inicioExecucao == -1) {
+                if (er.status->emitido == cicloAtual) continue;
+                if (!reservarUnidade(FU_ADD_SUB, *er.status, er.tipoInstrucao, er.nome)) continue;
+                er.status->inicioExecucao = cicloAtual;
+                if (!modoBatch) logEventos += "-> " + er.nome + " iniciou execucao (" + NOMES_TIPOS_INSTRUCAO[er.tipoInstrucao] + ").\n";
             }
 
             if (er.ciclosRestantes > 0) {
                 er.ciclosRestantes--;
-                er.instrucao->status.ciclosRestantesExecucao = er.ciclosRestantes;
-                logEventos += "-> " + er.nome + " completou 1 ciclo. Restantes: " +
-                              to_string(er.ciclosRestantes) + ".\n";
+                er.status->ciclosRestantesExecucao = er.ciclosRestantes;
+                if (!modoBatch) logEventos += "-> " + er.nome + " completou 1 ciclo. Restantes: " +
+                                              to_string(er.ciclosRestantes) + ".\n";
                 if (er.ciclosRestantes == 0) {
-                    er.instrucao->status.fimExecucao = cicloAtual;
-                    logEventos += "-> " + er.nome + " completou execucao.\n";
+                    er.status->fimExecucao = cicloAtual;
+                    if (!modoBatch) logEventos += "-> " + er.nome + " completou execucao.\n";
                 }
             }
         }
@@ -777,208 +3611,625 @@ struct Tomasulo {
         for (int i = 0; i < numEstacoesMultDiv; i++) {
             EstacaoReserva& er = estacoesMultDiv[i];
             if (!er.ocupado || !er.instrucao) continue;
-            if (!er.origemJ.empty() || !er.origemK.empty()) continue;
+            if (er.origemJ != SEM_UNIDADE || er.origemK != SEM_UNIDADE) continue;
 
-            if (er.instrucao->status.inicioExecucao == -1) {
-                if (er.instrucao->status.emitido == cicloAtual) continue;
-                er.instrucao->status.inicioExecucao = cicloAtual;
-                logEventos += "-> " + er.nome + " iniciou execucao (" + er.tipoInstrucao + ").\n";
+            if (er.status->inicioExecucao == -1) {
+                if (er.status->emitido == cicloAtual) continue;
+                if (!reservarUnidade(FU_MUL_DIV, *er.status, er.tipoInstrucao, er.nome)) continue;
+                er.status->inicioExecucao = cicloAtual;
+                if (!modoBatch) logEventos += "-> " + er.nome + " iniciou execucao (" + NOMES_TIPOS_INSTRUCAO[er.tipoInstrucao] + ").\n";
             }
 
             if (er.ciclosRestantes > 0) {
                 er.ciclosRestantes--;
-                er.instrucao->status.ciclosRestantesExecucao = er.ciclosRestantes;
-                logEventos += "-> " + er.nome + " completou 1 ciclo. Restantes: " +
-                              to_string(er.ciclosRestantes) + ".\n";
+                er.status->ciclosRestantesExecucao = er.ciclosRestantes;
+                if (!modoBatch) logEventos += "-> " + er.nome + " completou 1 ciclo. Restantes: " +
+                                              to_string(er.ciclosRestantes) + ".\n";
                 if (er.ciclosRestantes == 0) {
-                    er.instrucao->status.fimExecucao = cicloAtual;
-                    logEventos += "-> " + er.nome + " completou execucao.\n";
+                    er.status->fimExecucao = cicloAtual;
+                    if (!modoBatch) logEventos += "-> " + er.nome + " completou execucao.\n";
                 }
             }
         }
     }
 
-    void escreverResultado_CDB_unico() {
-        bool escreveu = false;
-        for (int turn = 0; turn < 3 && !escreveu; ++turn) {
-            int cls = (cdb_rr + turn) % 3;
-
-            if (cls == 0) {
-                for (int i = 0; i < numEstacoesAddSub; i++) {
-                    EstacaoReserva& er = estacoesAddSub[i];
-                    if (!er.ocupado || !er.instrucao) continue;
-                    if (er.ciclosRestantes != 0) continue;
-                    if (er.instrucao->status.fimExecucao == cicloAtual) continue;
-                    if (er.instrucao->status.escritaResultado != -1) continue;
-
-                    if (er.tipoInstrucao == TiposInstrucao::BNE) {
-                        int vj = er.valorJ;
-                        int vk = er.valorK;
-                        bool taken = (vj != vk);
-                        branchResolved = true;
-                        branchTaken = taken;
-                        if (taken) {
-                            int idx = branchIssuedIndex;
-                            branchTarget = idx + 1 + er.instrucao->offsetImediato;
-                            if (branchTarget < 0) branchTarget = 0;
-                            if (branchTarget > numInstrucoes) branchTarget = numInstrucoes;
-                        }
-                        er.instrucao->status.escritaResultado = cicloAtual;
-                        logEventos += "-> BNE resolvido: " + string(taken ? "TAKEN" : "NOT TAKEN") + ".\n";
-
-                        er.ocupado = false;
-                        er.tipoInstrucao.clear();
-                        er.origemJ.clear();
-                        er.origemK.clear();
-                        er.instrucao = nullptr;
-                        er.destReg = -1;
-                        er.ciclosRestantes = -1;
+    // Unidade pronta para escrever no CDB neste ciclo
+    struct CandidatoCDB {
+        int classe;           // 0=ADD/SUB/BNE, 1=MUL/DIV, 2=LOAD
+        long long ordem;      // StatusInstrucao::sequencia
+        int latencia;         // latência de execução configurada
+        EstacaoReserva* er;
+        BufferLoad* lb;
+    };
+
+    vector<CandidatoCDB> candidatosCDB() {
+        vector<CandidatoCDB> cands;
+        for (int i = 0; i < numEstacoesAddSub; i++) {
+            EstacaoReserva& er = estacoesAddSub[i];
+            if (!er.ocupado || !er.instrucao) continue;
+            if (er.ciclosRestantes != 0) continue;
+            if (er.status->fimExecucao == cicloAtual) continue;
+            if (er.status->escritaResultado != -1) continue;
+            int lat = ehDesvio(er.tipoInstrucao) ? 1 : ciclosAddSub;
+            cands.push_back({ 0, er.status->sequencia, lat, &er, nullptr });
+        }
+        for (int i = 0; i < numEstacoesMultDiv; i++) {
+            EstacaoReserva& er = estacoesMultDiv[i];
+            if (!er.ocupado || !er.instrucao) continue;
+            if (er.ciclosRestantes != 0) continue;
+            if (er.status->fimExecucao == cicloAtual) continue;
+            if (er.status->escritaResultado != -1) continue;
+            int lat = er.tipoInstrucao == TiposInstrucao::MULT ? ciclosMult : ciclosDiv;
+            cands.push_back({ 1, er.status->sequencia, lat, &er, nullptr });
+        }
+        for (int i = 0; i < numBuffersCarregamento; i++) {
+            BufferLoad& lb = buffersCarregamento[i];
+            if (!lb.ocupado || !lb.instrucao) continue;
+            if (!lb.resultReady) continue;
+            if (lb.status->escritaResultado != -1) continue;
+            cands.push_back({ 2, lb.status->sequencia, lb.latencia, nullptr, &lb });
+        }
+        return cands;
+    }
 
+    // Escolhe até numCDBs candidatos segundo a política de arbitragem
+    vector<CandidatoCDB> arbitrarCDB(vector<CandidatoCDB>& cands) {
+        vector<CandidatoCDB> escolhidos;
+        if (politicaCDB == CDB_ROUND_ROBIN) {
+            // Rodízio entre classes: cada barramento pega o primeiro candidato da
+            // próxima classe com trabalho, a partir de cdb_rr
+            vector<bool> usado(cands.size(), false);
+            for (int bus = 0; bus < numCDBs; bus++) {
+                bool achou = false;
+                for (int turn = 0; turn < 3 && !achou; ++turn) {
+                    int cls = (cdb_rr + turn) % 3;
+                    for (size_t c = 0; c < cands.size(); c++) {
+                        if (usado[c] || cands[c].classe != cls) continue;
+                        usado[c] = true;
+                        escolhidos.push_back(cands[c]);
                         cdb_rr = (cls + 1) % 3;
-                        escreveu = true;
+                        achou = true;
                         break;
-                    } else {
-                        int resultado = 0;
-                        if (er.tipoInstrucao == TiposInstrucao::SOMA)
-                            resultado = er.valorJ + er.valorK;
-                        else if (er.tipoInstrucao == TiposInstrucao::SUBT)
-                            resultado = er.valorJ - er.valorK;
-
-                        er.instrucao->status.escritaResultado = cicloAtual;
-                        logEventos += "-> " + er.nome + " escreveu resultado no CDB.\n";
-
-                        if (er.destReg >= 0 &&
-                            estadoRegistradores[er.destReg].unidadeEscritora == er.nome) {
-                            estadoRegistradores[er.destReg].unidadeEscritora.clear();
-                            registradores[er.destReg].valor = resultado;
-                        }
+                    }
+                }
+                if (!achou) break;
+            }
+            return escolhidos;
+        }
 
-                        transmitirResultado(resultado, er.nome);
+        // Demais políticas: ordenação estável por prioridade
+        if (politicaCDB == CDB_MAIS_ANTIGA) {
+            stable_sort(cands.begin(), cands.end(),
+                        [](const CandidatoCDB& a, const CandidatoCDB& b){ return a.ordem < b.ordem; });
+        } else if (politicaCDB == CDB_MAIOR_LATENCIA) {
+            stable_sort(cands.begin(), cands.end(),
+                        [](const CandidatoCDB& a, const CandidatoCDB& b){
+                            if (a.latencia != b.latencia) return a.latencia > b.latencia;
+                            return a.ordem < b.ordem;
+                        });
+        } else { // CDB_PRIORIDADE_FIXA: ADD/SUB/BNE > MUL/DIV > LOAD
+            stable_sort(cands.begin(), cands.end(),
+                        [](const CandidatoCDB& a, const CandidatoCDB& b){ return a.classe < b.classe; });
+        }
+        for (size_t c = 0; c < cands.size() && (int)c < numCDBs; c++)
+            escolhidos.push_back(cands[c]);
+        return escolhidos;
+    }
 
-                        er.ocupado = false;
-                        er.tipoInstrucao.clear();
-                        er.instrucao = nullptr;
-                        er.origemJ.clear();
-                        er.origemK.clear();
-                        er.ciclosRestantes = -1;
-                        er.destReg = -1;
+    void registrarEsperaCDB(StatusInstrucao& st) {
+        st.ciclosEsperaCDB = cicloAtual - st.fimExecucao - 1;
+        totalEsperaCDB += st.ciclosEsperaCDB;
+        maiorEsperaCDB = max(maiorEsperaCDB, st.ciclosEsperaCDB);
+        escritasCDB++;
+    }
 
-                        cdb_rr = (cls + 1) % 3;
-                        escreveu = true;
-                        break;
-                    }
+    void escreverResultadoER(EstacaoReserva& er) {
+        registrarEsperaCDB(*er.status);
+        if (ehDesvio(er.tipoInstrucao)) {
+            int vj = er.valorJ;
+            int vk = er.valorK;
+            bool taken = er.tipoInstrucao == TiposInstrucao::BEQ ? vj == vk : vj != vk;
+            er.status->escritaResultado = cicloAtual;
+            if (!modoBatch) logEventos += "-> " + string(NOMES_TIPOS_INSTRUCAO[er.tipoInstrucao]) + " resolvido: " + string(taken ? "TAKEN" : "NOT TAKEN") + ".\n";
+            if (er.entradaROB >= 0) {
+                int e = er.entradaROB;
+                liberarER(er);
+                resolverDesvioROB(e, taken);
+                return;
+            }
+            branchResolved = true;
+            branchTaken = taken;
+            if (taken) branchTarget = alvoDesvio(branchIssuedIndex);
+            instrucoesConcluidas++;
+        } else {
+            int resultado = 0;
+            if (er.tipoInstrucao == TiposInstrucao::SOMA)
+                resultado = er.valorJ + er.valorK;
+            else if (er.tipoInstrucao == TiposInstrucao::SUBT)
+                resultado = er.valorJ - er.valorK;
+            else if (er.tipoInstrucao == TiposInstrucao::MULT)
+                resultado = er.valorJ * er.valorK;
+            else if (er.tipoInstrucao == TiposInstrucao::DIVI)
+                resultado = (er.valorK == 0) ? 0 : er.valorJ / er.valorK;
+
+            er.status->escritaResultado = cicloAtual;
+            if (!modoBatch) logEventos += "-> " + er.nome + " escreveu resultado no CDB.\n";
+
+            if (er.entradaROB >= 0) {
+                rob[er.entradaROB].pronto = true;
+                rob[er.entradaROB].valor = resultado;
+            } else {
+                instrucoesConcluidas++;
+                if (er.destReg >= 0 &&
+                    estadoRegistradores[er.destReg].unidadeEscritora == er.id) {
+                    estadoRegistradores[er.destReg].unidadeEscritora = SEM_UNIDADE;
+                    escreverRegistrador(er.destReg, resultado);
                 }
-            } else if (cls == 1) {
-                for (int i = 0; i < numEstacoesMultDiv; i++) {
-                    EstacaoReserva& er = estacoesMultDiv[i];
-                    if (!er.ocupado || !er.instrucao) continue;
-                    if (er.ciclosRestantes != 0) continue;
-                    if (er.instrucao->status.fimExecucao == cicloAtual) continue;
-                    if (er.instrucao->status.escritaResultado != -1) continue;
-
-                    int resultado = 0;
-                    if (er.tipoInstrucao == TiposInstrucao::MULT)
-                        resultado = er.valorJ * er.valorK;
-                    else if (er.tipoInstrucao == TiposInstrucao::DIVI)
-                        resultado = (er.valorK == 0) ? 0 : er.valorJ / er.valorK;
-
-                    er.instrucao->status.escritaResultado = cicloAtual;
-                    logEventos += "-> " + er.nome + " escreveu resultado no CDB.\n";
-
-                    if (er.destReg >= 0 &&
-                        estadoRegistradores[er.destReg].unidadeEscritora == er.nome) {
-                        estadoRegistradores[er.destReg].unidadeEscritora.clear();
-                        registradores[er.destReg].valor = resultado;
-                    }
+            }
+
+            transmitirResultado(resultado, er.id);
+        }
 
-                    transmitirResultado(resultado, er.nome);
+        liberarER(er);
+    }
 
-                    er.ocupado = false;
-                    er.tipoInstrucao.clear();
-                    er.instrucao = nullptr;
-                    er.origemJ.clear();
-                    er.origemK.clear();
-                    er.ciclosRestantes = -1;
-                    er.destReg = -1;
+    // Guarda no status da instrução o registro da instância mais recente
+    void publicarRegistro(const Instrucao& instr, const StatusInstrucao& st) {
+        StatusInstrucao& publicado = statusInstrucoes[&instr - instrucoes];
+        if (st.sequencia < publicado.sequencia) return;
+        if (escritas) escritas->anotar(&publicado, sizeof(StatusInstrucao));
+        publicado = st;
+    }
 
-                    cdb_rr = (cls + 1) % 3;
-                    escreveu = true;
-                    break;
-                }
-            } else {
-                for (int i = 0; i < numBuffersCarregamento; i++) {
-                    BufferLoad& lb = buffersCarregamento[i];
-                    if (!lb.ocupado || !lb.instrucao) continue;
-                    if (!lb.resultReady) continue;
-                    if (lb.instrucao->status.escritaResultado != -1) continue;
-
-                    lb.instrucao->status.escritaResultado = cicloAtual;
-                    logEventos += "-> " + lb.nome + " escreveu resultado no CDB.\n";
-
-                    if (lb.destReg >= 0 &&
-                        estadoRegistradores[lb.destReg].unidadeEscritora == lb.nome) {
-                        estadoRegistradores[lb.destReg].unidadeEscritora.clear();
-                        registradores[lb.destReg].valor = lb.resultado;
-                    }
+    // Registro exibido para a instrução: a instância mais nova ainda em voo,
+    // ou a última concluída
+    const StatusInstrucao& registroVisivel(int i) const {
+        const Instrucao* instr = &instrucoes[i];
+        const StatusInstrucao* melhor = &statusInstrucoes[i];
+        auto considerar = [&](const Instrucao* dono, const StatusInstrucao* st) {
+            if (dono == instr && st && st->sequencia > melhor->sequencia) melhor = st;
+        };
+        if (tamanhoROB > 0) {
+            for (int k = 0; k < robOcupadas; k++) {
+                const EntradaROB& ent = rob[(robCabeca + k) % tamanhoROB];
+                considerar(&instrucoes[ent.indiceInstrucao], ent.status);
+            }
+            return *melhor;
+        }
+        for (int k = 0; k < numEstacoesAddSub; k++)
+            if (estacoesAddSub[k].ocupado) considerar(estacoesAddSub[k].instrucao, estacoesAddSub[k].status);
+        for (int k = 0; k < numEstacoesMultDiv; k++)
+            if (estacoesMultDiv[k].ocupado) considerar(estacoesMultDiv[k].instrucao, estacoesMultDiv[k].status);
+        for (int k = 0; k < numBuffersCarregamento; k++)
+            if (buffersCarregamento[k].ocupado) considerar(buffersCarregamento[k].instrucao, buffersCarregamento[k].status);
+        for (int k = 0; k < numBuffersArmazenamento; k++)
+            if (buffersArmazenamento[k].ocupado) considerar(buffersArmazenamento[k].instrucao, buffersArmazenamento[k].status);
+        return *melhor;
+    }
 
-                    transmitirResultado(lb.resultado, lb.nome);
+    void liberarER(EstacaoReserva& er) {
+        if (er.entradaROB >= 0) rob[er.entradaROB].er = nullptr;
+        else if (er.status) retirarInstancia(*er.instrucao, er.status);
+        er.ocupado = false;
+        er.tipoInstrucao = TiposInstrucao::NOP;
+        er.instrucao = nullptr;
+        er.status = nullptr;
+        er.entradaROB = -1;
+        er.origemJ = SEM_UNIDADE;
+        er.origemK = SEM_UNIDADE;
+        er.ciclosRestantes = -1;
+        er.destReg = -1;
+    }
 
-                    lb.ocupado = false;
-                    lb.instrucao = nullptr;
-                    lb.ciclosRestantes = -1;
-                    lb.resultReady = false;
-                    lb.origemBase.clear();
-                    lb.hasForward = false;
-                    lb.forwardVal = 0;
+    void liberarLoad(BufferLoad& lb) {
+        filaLS.remover(&lb);
+        if (lb.entradaROB >= 0) rob[lb.entradaROB].lb = nullptr;
+        else if (lb.status) retirarInstancia(*lb.instrucao, lb.status);
+        lb.ocupado = false;
+        lb.instrucao = nullptr;
+        lb.status = nullptr;
+        lb.entradaROB = -1;
+        lb.ciclosRestantes = -1;
+        lb.resultReady = false;
+        lb.origemBase = SEM_UNIDADE;
+        lb.hasForward = false;
+        lb.forwardVal = 0;
+    }
 
-                    cdb_rr = (cls + 1) % 3;
-                    escreveu = true;
-                    break;
-                }
+    void liberarStore(BufferStore& sb) {
+        filaLS.remover(&sb);
+        if (sb.entradaROB >= 0) rob[sb.entradaROB].sb = nullptr;
+        else if (sb.status) retirarInstancia(*sb.instrucao, sb.status);
+        sb.ocupado = false;
+        sb.instrucao = nullptr;
+        sb.status = nullptr;
+        sb.entradaROB = -1;
+        sb.ciclosRestantes = -1;
+        sb.origemBase = SEM_UNIDADE;
+        sb.origemVal = SEM_UNIDADE;
+    }
+
+    // BNE resolvido com ROB: confere a previsão, treina o preditor e, se ela
+    // errou, descarta o caminho errado e redireciona a busca
+    void resolverDesvioROB(int e, bool tomado) {
+        EntradaROB& br = rob[e];
+        br.pronto = true;
+        desviosResolvidos++;
+        preditor.atualizar(br.indiceInstrucao, br.historico, tomado);
+        if (tomado == br.previstoTomado) return;
+
+        desviosErrados++;
+        ciclosPenalidade += cicloAtual - br.status->emitido;
+        int descartadas = descartarAposEntrada(e);
+        instrucoesDescartadas += descartadas;
+        preditor.restaurar(br.historico, tomado);
+        proxBusca = tomado ? alvoDesvio(br.indiceInstrucao) : br.indiceInstrucao + 1;
+        if (!modoBatch) logEventos += "-> Previsao errada no desvio " + to_string(br.indiceInstrucao) + ": " +
+                                      to_string(descartadas) + " instrucao(oes) descartada(s).\n";
+    }
+
+    // STORE que acabou de ter o endereço resolvido: se um LOAD mais novo do mesmo
+    // endereço já leu um valor mais antigo que ele, o LOAD leu o dado errado.
+    // O preditor aprende a dependência e o LOAD é reexecutado junto com todas
+    // as instruções seguintes (descarte a partir dele e nova busca).
+    void verificarViolacaoMemoria(BufferStore& sb) {
+        if (!preditorMem.ativo || sb.entradaROB < 0) return;
+        int e = sb.entradaROB;
+        long long ordemSt = sb.status->sequencia;
+        int pos = (e - robCabeca + tamanhoROB) % tamanhoROB;
+        for (int k = 1; k < robOcupadas - pos; k++) {
+            int idx = (e + k) % tamanhoROB;
+            EntradaROB& ld = rob[idx];
+            if (!ld.leuMemoria || ld.enderecoLido != sb.endereco || ld.ordemFonte > ordemSt) continue;
+
+            int pcLoad = ld.indiceInstrucao;
+            unsigned historico = ld.historico;
+            violacoesMemoria++;
+            preditorMem.unir(pcLoad, (int)(sb.instrucao - instrucoes));
+            filaLS.loadsDesatualizados = true;
+            int descartadas = descartarAposEntrada((idx - 1 + tamanhoROB) % tamanhoROB);
+            instrucoesReexecutadas += descartadas;
+            preditor.historico = historico;
+            proxBusca = pcLoad;
+            if (!modoBatch) logEventos += "-> Violacao de memoria: LOAD " + to_string(pcLoad) + " leu [" +
+                                          to_string(sb.endereco) + "] antes de " + sb.nome + "; " +
+                                          to_string(descartadas) + " instrucao(oes) reexecutada(s).\n";
+            return;
+        }
+    }
+
+    // Descarta todas as entradas do ROB mais novas que 'e', libera suas
+    // estações/buffers, esvazia a fila de busca e refaz o mapeamento dos
+    // registradores a partir das entradas que sobraram
+    int descartarAposEntrada(int e) {
+        int pos = (e - robCabeca + tamanhoROB) % tamanhoROB;
+        int descartar = robOcupadas - pos - 1;
+        for (int k = 1; k <= descartar; k++) {
+            EntradaROB& x = rob[(e + k) % tamanhoROB];
+            if (x.er) { dependentes[x.er->id].clear(); liberarER(*x.er); }
+            if (x.lb) { dependentes[x.lb->id].clear(); liberarLoad(*x.lb); }
+            if (x.sb) liberarStore(*x.sb);
+            instancias.liberar(x.status);
+            x.ocupado = false;
+        }
+        robOcupadas -= descartar;
+        robCauda = (e + 1) % tamanhoROB;
+        filaInstrucoes.clear();
+
+        for (int r = 0; r < numTotalRegistradores; r++)
+            estadoRegistradores[r].entradaROB = -1;
+        for (int k = 0; k <= pos; k++) {
+            int idx = (robCabeca + k) % tamanhoROB;
+            if (rob[idx].destReg >= 0)
+                estadoRegistradores[rob[idx].destReg].entradaROB = idx;
+        }
+        return descartar;
+    }
+
+    // Commit em ordem: até larguraEmissao entradas prontas a partir da cabeça.
+    // Registradores e memória (STORE) só são alterados aqui.
+    void confirmarROB() {
+        for (int n = 0; n < larguraEmissao && robOcupadas > 0; n++) {
+            EntradaROB& ent = rob[robCabeca];
+            if (!ent.pronto) break;
+            const Instrucao& instr = instrucoes[ent.indiceInstrucao];
+            if (ent.sb) {
+                BufferStore& sb = *ent.sb;
+                int addr = sb.baseVal + instr.offsetImediato;
+                escreverMemoria(addr, sb.value);
+                if (!modoBatch) enderecosEscritos.push_back(addr);
+                ent.status->escritaResultado = cicloAtual;
+                if (!modoBatch) logEventos += "-> " + sb.nome + " comitou na memoria ["
+                                              + to_string(addr) + "]=" + to_string(sb.value) + ".\n";
+                liberarStore(sb);
+            } else if (ent.destReg >= 0) {
+                escreverRegistrador(ent.destReg, ent.valor);
+                if (estadoRegistradores[ent.destReg].entradaROB == robCabeca)
+                    estadoRegistradores[ent.destReg].entradaROB = -1;
             }
+            ent.status->commit = cicloAtual;
+            retirarInstancia(instr, ent.status);
+            instrucoesConcluidas++;
+            if (!modoBatch) logEventos += "-> ROB" + to_string(robCabeca) + " comitou a instrucao " +
+                                          to_string(ent.indiceInstrucao) + ".\n";
+            ent.ocupado = false;
+            robCabeca = (robCabeca + 1) % tamanhoROB;
+            robOcupadas--;
         }
     }
 
-    void escreverResultado_STOREs() {
-        struct Cand { BufferStore* buf; int emit; };
-        vector<Cand> prontos;
+    void escreverResultadoLoad(BufferLoad& lb) {
+        registrarEsperaCDB(*lb.status);
+        lb.status->escritaResultado = cicloAtual;
+        if (!modoBatch) logEventos += "-> " + lb.nome + " escreveu resultado no CDB.\n";
 
-        for (int i = 0; i < numBuffersArmazenamento; ++i) {
-            BufferStore& sb = buffersArmazenamento[i];
-            if (!sb.ocupado || !sb.instrucao) continue;
-            if (sb.ciclosRestantes != 0) continue;
-            if (sb.instrucao->status.fimExecucao == -1) continue;
-            if (sb.instrucao->status.escritaResultado != -1) continue;
-            prontos.push_back({ &sb, sb.instrucao->status.emitido });
+        if (lb.entradaROB >= 0) {
+            rob[lb.entradaROB].pronto = true;
+            rob[lb.entradaROB].valor = lb.resultado;
+        } else {
+            instrucoesConcluidas++;
+            if (lb.destReg >= 0 &&
+                estadoRegistradores[lb.destReg].unidadeEscritora == lb.id) {
+                estadoRegistradores[lb.destReg].unidadeEscritora = SEM_UNIDADE;
+                escreverRegistrador(lb.destReg, lb.resultado);
+            }
         }
 
-        if (prontos.empty()) return;
+        transmitirResultado(lb.resultado, lb.id);
+        liberarLoad(lb);
+    }
 
-        sort(prontos.begin(), prontos.end(),
-             [](const Cand& a, const Cand& b){ return a.emit < b.emit; });
+    // Write-back: até numCDBs resultados por ciclo, escolhidos pela política
+    // configurada. BNE é resolvido aqui e também ocupa um barramento.
+    void escreverResultado_CDB() {
+        vector<CandidatoCDB> cands = candidatosCDB();
+        if (cands.empty()) return;
+        vector<CandidatoCDB> escolhidos = arbitrarCDB(cands);
+        if (tamanhoROB > 0) {
+            // Em ordem de idade, para que um desvio errado descarte os mais novos
+            // antes que eles escrevam
+            sort(escolhidos.begin(), escolhidos.end(),
+                 [](const CandidatoCDB& a, const CandidatoCDB& b){ return a.ordem < b.ordem; });
+        }
+        for (const CandidatoCDB& c : escolhidos) {
+            if (c.er) { if (c.er->ocupado) escreverResultadoER(*c.er); }
+            else if (c.lb->ocupado) escreverResultadoLoad(*c.lb);
+        }
+        // Bases de LOAD/STORE recebidas no broadcast
+        for (BufferStore* sb : filaLS.resolverEnderecos())
+            if (sb->ocupado) verificarViolacaoMemoria(*sb);
+        if (cands.size() > escolhidos.size())
+            if (!modoBatch) logEventos += "-> " + to_string(cands.size() - escolhidos.size()) +
+                                          " resultado(s) aguardando CDB livre.\n";
+    }
 
-        for (auto& c : prontos) {
-            BufferStore& sb = *c.buf;
-            if (!sb.origemBase.empty() || !sb.origemVal.empty()) continue;
+    void escreverResultado_STOREs() {
+        // Só os STOREs que terminaram a execução, já em ordem de programa
+        vector<BufferStore*> prontos;
+        for (const auto& e : filaLS.storesProntos) prontos.push_back(e.second);
+
+        for (BufferStore* c : prontos) {
+            BufferStore& sb = *c;
+            if (sb.origemBase != SEM_UNIDADE || sb.origemVal != SEM_UNIDADE) continue;
+            if (filaLS.storeBloqueado(&sb)) {
+                if (!modoBatch) logEventos += "-> " + sb.nome + " aguardando acesso anterior ao mesmo endereco.\n";
+                continue;
+            }
 
             int addr = sb.baseVal + sb.instrucao->offsetImediato;
             int val  = sb.value;
             escreverMemoria(addr, val);
+            if (!modoBatch) enderecosEscritos.push_back(addr);
+
+            sb.status->escritaResultado = cicloAtual;
+            instrucoesConcluidas++;
+            if (!modoBatch) logEventos += "-> " + sb.nome + " comitou na memoria ["
+                                          + to_string(addr) + "]=" + to_string(val) + ".\n";
+
+            liberarStore(sb);
+        }
+    }
+
+    // Estado de um ocupante de unidade no fim do ciclo 'ciclo' (CategoriaCiclo)
+    int categoriaER(const EstacaoReserva& er, int ciclo) const {
+        const StatusInstrucao& st = *er.status;
+        if (er.ciclosRestantes == 0)
+            return st.fimExecucao == ciclo ? CICLO_EXECUCAO : CICLO_CDB;
+        if (st.inicioExecucao != -1) return CICLO_EXECUCAO;
+        if (er.origemJ != SEM_UNIDADE || er.origemK != SEM_UNIDADE) return CICLO_DEPENDENCIA;
+        return st.emitido == ciclo ? CICLO_EXECUCAO : CICLO_UNIDADE;
+    }
+
+    int categoriaLoad(const BufferLoad& lb, int ciclo) const {
+        const StatusInstrucao& st = *lb.status;
+        if (lb.resultReady)
+            return st.fimExecucao == ciclo ? CICLO_EXECUCAO : CICLO_CDB;
+        if (st.inicioExecucao != -1) return ciclo <= lb.fimEspera ? CICLO_BANDA : CICLO_EXECUCAO;
+        if (lb.origemBase != SEM_UNIDADE) return CICLO_DEPENDENCIA;
+        if (lb.esperaStore) return CICLO_MEMORIA;
+        return st.emitido == ciclo ? CICLO_EXECUCAO : CICLO_UNIDADE;
+    }
+
+    int categoriaStore(const BufferStore& sb, int ciclo) const {
+        const StatusInstrucao& st = *sb.status;
+        if (sb.ciclosRestantes == 0) {
+            if (tamanhoROB > 0) return CICLO_COMMIT;
+            return st.fimExecucao == ciclo ? CICLO_EXECUCAO : CICLO_MEMORIA;
+        }
+        if (st.inicioExecucao != -1) return ciclo <= sb.fimEspera ? CICLO_BANDA : CICLO_EXECUCAO;
+        if (sb.origemBase != SEM_UNIDADE || sb.origemVal != SEM_UNIDADE) return CICLO_DEPENDENCIA;
+        return st.emitido == ciclo ? CICLO_EXECUCAO : CICLO_UNIDADE;
+    }
+
+    // Soma 'ciclos' ciclos no estado visto no fim de 'ciclo' à pilha de CPI e aos
+    // contadores por unidade. 'concluida': classe da primeira instrução concluída
+    // no ciclo (-1 nenhuma). Os ciclos saltados contam como o seguinte ao atual.
+    void contabilizarCiclos(int ciclo, long long ciclos, int concluida) {
+        // O ciclo vai para a instrução mais antiga que não está executando: uma
+        // mais antiga em execução não explica por que as outras não avançam
+        long long maisAntiga = -1, maisAntigaExecutando = -1;
+        int categoria = -1, classe = -1, classeExecutando = -1;
+        auto ocupante = [&](int tag, const StatusInstrucao* st, const Instrucao* instr, int cat) {
+            ciclosPorUnidade[tag][cat] += ciclos;
+            if (cat == CICLO_EXECUCAO) {
+                if (maisAntigaExecutando == -1 || st->sequencia < maisAntigaExecutando) {
+                    maisAntigaExecutando = st->sequencia;
+                    classeExecutando = classeInstrucao(instr->tipoInstrucao);
+                }
+            } else if (maisAntiga == -1 || st->sequencia < maisAntiga) {
+                maisAntiga = st->sequencia;
+                categoria = cat;
+                classe = classeInstrucao(instr->tipoInstrucao);
+            }
+        };
+        for (int i = 0; i < numBuffersCarregamento; i++) {
+            BufferLoad& lb = buffersCarregamento[i];
+            if (lb.ocupado && lb.instrucao) ocupante(lb.id, lb.status, lb.instrucao, categoriaLoad(lb, ciclo));
+        }
+        for (int i = 0; i < numBuffersArmazenamento; i++) {
+            BufferStore& sb = buffersArmazenamento[i];
+            if (sb.ocupado && sb.instrucao) ocupante(sb.id, sb.status, sb.instrucao, categoriaStore(sb, ciclo));
+        }
+        for (int i = 0; i < numEstacoesAddSub; i++) {
+            EstacaoReserva& er = estacoesAddSub[i];
+            if (er.ocupado && er.instrucao) ocupante(er.id, er.status, er.instrucao, categoriaER(er, ciclo));
+        }
+        for (int i = 0; i < numEstacoesMultDiv; i++) {
+            EstacaoReserva& er = estacoesMultDiv[i];
+            if (er.ocupado && er.instrucao) ocupante(er.id, er.status, er.instrucao, categoriaER(er, ciclo));
+        }
+        if (categoria == -1 && maisAntigaExecutando != -1) {
+            categoria = CICLO_EXECUCAO;
+            classe = classeExecutando;
+        }
+        // A cabeça do ROB é a mais antiga; pronta, já deixou a unidade
+        if (robOcupadas > 0 && rob[robCabeca].pronto) {
+            categoria = CICLO_COMMIT;
+            classe = classeInstrucao(instrucoes[rob[robCabeca].indiceInstrucao].tipoInstrucao);
+        }
 
-            sb.instrucao->status.escritaResultado = cicloAtual;
-            logEventos += "-> " + sb.nome + " comitou na memoria ["
-                          + to_string(addr) + "]=" + to_string(val) + ".\n";
+        if (concluida != -1) {
+            categoria = CICLO_BASE;
+            classe = concluida;
+        } else if (categoria == -1) categoria = (branchPending || buscaBloqueada) ? CICLO_DESVIO : CICLO_FRONT_END;
+        pilhaCPI[categoria] += ciclos;
+        if (classe >= 0) pilhaCPIPorClasse[categoria][classe] += ciclos;
+    }
+
+    // Quantos ciclos a partir do próximo são "ociosos": nenhuma escrita no CDB,
+    // nenhum commit de STORE, nenhuma unidade iniciando execução, nenhuma
+    // emissão possível e nenhuma execução terminando. Nesses ciclos o estado só
+    // muda pela contagem regressiva, que pode ser aplicada de uma vez.
+    int ciclosOciososAFrente() {
+        int menorRestante = -1;
+        auto contar = [&](int restantes) {
+            if (menorRestante == -1 || restantes < menorRestante) menorRestante = restantes;
+        };
+        // Instrução pronta para iniciar: só não é evento se todas as unidades do
+        // grupo seguem ocupadas no próximo ciclo (conta até a primeira liberar)
+        auto semUnidade = [&](int g) {
+            const GrupoUnidades& grupo = unidades[g];
+            if (grupo.quantidade == 0 || grupo.unidadeLivre(cicloAtual + 1) >= 0) return false;
+            contar(grupo.proximaLiberacao() - cicloAtual);
+            return true;
+        };
+
+        for (int i = 0; i < numBuffersCarregamento; i++) {
+            BufferLoad& lb = buffersCarregamento[i];
+            if (!lb.ocupado || !lb.instrucao) continue;
+            if (lb.resultReady) return 0;
+            if (lb.esperaStore) continue;
+            if (lb.status->inicioExecucao == -1) {
+                if (semUnidade(FU_LOAD_STORE)) continue;
+                return 0;
+            }
+            // A pilha de CPI muda de categoria quando o acesso sai da fila
+            if (lb.fimEspera > cicloAtual) contar(lb.fimEspera - cicloAtual + 1);
+            contar(lb.ciclosRestantes);
+        }
+        for (int i = 0; i < numBuffersArmazenamento; i++) {
+            BufferStore& sb = buffersArmazenamento[i];
+            if (!sb.ocupado || !sb.instrucao) continue;
+            if (sb.ciclosRestantes == 0) {
+                // commit do STORE, a menos que espere um acesso anterior (que só
+                // avança por outro evento) ou a cabeça do ROB
+                if (tamanhoROB == 0 && !filaLS.storeBloqueado(&sb)) return 0;
+                continue;
+            }
+            if (sb.origemBase != SEM_UNIDADE || sb.origemVal != SEM_UNIDADE) continue;
+            if (sb.status->inicioExecucao == -1) {
+                if (semUnidade(FU_LOAD_STORE)) continue;
+                return 0;
+            }
+            // A pilha de CPI muda de categoria quando o acesso sai da fila
+            if (sb.fimEspera > cicloAtual) contar(sb.fimEspera - cicloAtual + 1);
+            contar(sb.ciclosRestantes);
+        }
+        for (int g = FU_ADD_SUB; g <= FU_MUL_DIV; g++) {
+            EstacaoReserva* ers = g == FU_ADD_SUB ? estacoesAddSub : estacoesMultDiv;
+            int n = g == FU_ADD_SUB ? numEstacoesAddSub : numEstacoesMultDiv;
+            for (int i = 0; i < n; i++) {
+                EstacaoReserva& er = ers[i];
+                if (!er.ocupado || !er.instrucao) continue;
+                if (er.ciclosRestantes == 0) return 0;
+                if (er.origemJ != SEM_UNIDADE || er.origemK != SEM_UNIDADE) continue;
+                if (er.status->inicioExecucao == -1) {
+                    if (semUnidade(g)) continue;
+                    return 0;
+                }
+                contar(er.ciclosRestantes);
+            }
+        }
+
+        if (robOcupadas > 0 && rob[robCabeca].pronto) return 0;
+
+        // A busca ainda enche a fila, ou a cabeça da fila pode ser emitida
+        if (!buscaBloqueada && !buscaSuspensa && proxBusca < numInstrucoes &&
+            (int)filaInstrucoes.size() < tamanhoFilaInstrucoes) return 0;
+        if (motivoEmissaoBloqueada() == -1) return 0;
 
-            sb.ocupado = false;
-            sb.instrucao = nullptr;
-            sb.ciclosRestantes = -1;
-            sb.origemBase.clear();
-            sb.origemVal.clear();
+        // Sem nenhuma contagem em andamento nada mais muda (deadlock): não salta
+        return menorRestante > 1 ? menorRestante - 1 : 0;
+    }
+
+    // Aplica em bloco 'k' ciclos ociosos (ver ciclosOciososAFrente)
+    void avancarCiclosOciosos(int k) {
+        for (int i = 0; i < numBuffersCarregamento; i++) {
+            BufferLoad& lb = buffersCarregamento[i];
+            if (!lb.ocupado || lb.status->inicioExecucao == -1) continue;
+            if (lb.esperaStore) continue;
+            lb.ciclosRestantes -= k;
+            lb.status->ciclosRestantesExecucao = lb.ciclosRestantes;
         }
+        for (int i = 0; i < numBuffersArmazenamento; i++) {
+            BufferStore& sb = buffersArmazenamento[i];
+            if (!sb.ocupado || sb.status->inicioExecucao == -1 || sb.ciclosRestantes == 0) continue;
+            sb.ciclosRestantes -= k;
+            sb.status->ciclosRestantesExecucao = sb.ciclosRestantes;
+        }
+        for (int g = 0; g < 2; g++) {
+            EstacaoReserva* ers = g == 0 ? estacoesAddSub : estacoesMultDiv;
+            int n = g == 0 ? numEstacoesAddSub : numEstacoesMultDiv;
+            for (int i = 0; i < n; i++) {
+                EstacaoReserva& er = ers[i];
+                if (!er.ocupado || er.status->inicioExecucao == -1) continue;
+                er.ciclosRestantes -= k;
+                er.status->ciclosRestantesExecucao = er.ciclosRestantes;
+            }
+        }
+        // Instruções esperando unidade funcional continuam esperando nesses ciclos
+        vector<pair<long long, StatusInstrucao*>> prontos[NUM_GRUPOS_FU];
+        prontosParaIniciar(cicloAtual + 1, prontos);
+        for (int g = 0; g < NUM_GRUPOS_FU; g++)
+            if (unidades[g].quantidade > 0) unidades[g].esperas += (long long)k * prontos[g].size();
+        registrarSlotsSemUso(0, motivoEmissaoBloqueada(), k);
+        cicloAtual += k;
     }
 
-    bool haTrabalhoPendente(int proxIndiceInstrucao) const {
-        if (proxIndiceInstrucao < numInstrucoes && !branchPending) return true;
+    bool haTrabalhoPendente() const {
+        if (!filaInstrucoes.empty()) return true;
+        if (robOcupadas > 0) return true;
+        if (proxBusca < numInstrucoes && !buscaBloqueada && !buscaSuspensa) return true;
         for (int i = 0; i < numBuffersCarregamento; ++i)
             if (buffersCarregamento[i].ocupado) return true;
         for (int i = 0; i < numBuffersArmazenamento; ++i)
@@ -987,237 +4238,1005 @@ struct Tomasulo {
             if (estacoesAddSub[i].ocupado) return true;
         for (int i = 0; i < numEstacoesMultDiv; ++i)
             if (estacoesMultDiv[i].ocupado) return true;
-        for (int i = 0; i < numInstrucoes; ++i)
-            if (instrucoes[i].status.emitido != -1 &&
-                instrucoes[i].status.escritaResultado == -1)
-                return true;
-        return false;
+        return instancias.ocupadas > 0;
+    }
+
+    static string nomeRegistrador(uint8_t r) {
+        return r == SEM_REGISTRADOR ? "" : "F" + to_string(r);
+    }
+
+    static string descreverInstrucao(const Instrucao& instr) {
+        string s = string(NOMES_TIPOS_INSTRUCAO[instr.tipoInstrucao]) + " ";
+        if (instr.tipoInstrucao == TiposInstrucao::CARREGA ||
+            instr.tipoInstrucao == TiposInstrucao::ARMAZENA) {
+            s += nomeRegistrador(instr.regFonte2) + ", " + to_string(instr.offsetImediato) +
+                 "(" + nomeRegistrador(instr.regFonte1) + ")";
+        } else if (ehDesvio(instr.tipoInstrucao)) {
+            s += nomeRegistrador(instr.regFonte1) + ", " + nomeRegistrador(instr.regFonte2) + ", " +
+                 to_string(instr.offsetImediato);
+        } else if (ehImediato(instr.tipoInstrucao)) {
+            s += nomeRegistrador(instr.regDestino) + ", " + nomeRegistrador(instr.regFonte1) + ", " +
+                 to_string(instr.offsetImediato);
+        } else if (instr.tipoInstrucao == TiposInstrucao::NOP) {
+            s.pop_back();
+        } else {
+            s += nomeRegistrador(instr.regDestino) + ", " + nomeRegistrador(instr.regFonte1) + ", " +
+                 nomeRegistrador(instr.regFonte2);
+        }
+        return s;
     }
 
-    void mostrarEstado() {
+    void mostrarEstado(const Instantaneo& q) const {
         int y = 2;
-        irPara(2, y); cout << "Instrucoes:";
-        irPara(27, y); cout << "Emitido" << " Comeco" << " Fim" << " Escrita";
-        irPara(27, y + 1); cout << "__________________________________";
+        irPara(2, y); tela.saida << "Instrucoes:";
+        irPara(27, y); tela.saida << "Emitido" << " Comeco" << " Fim" << " Escrita";
+        irPara(27, y + 1); tela.saida << "__________________________________";
 
         int offset = 0;
         for (int i = 0; i < numInstrucoes; i++) {
             irPara(2, offset + y + 2);
-            string instrStr = to_string(i) + ". " + instrucoes[i].tipoInstrucao + " ";
-            if (instrucoes[i].tipoInstrucao == TiposInstrucao::CARREGA ||
-                instrucoes[i].tipoInstrucao == TiposInstrucao::ARMAZENA) {
-                instrStr += instrucoes[i].regFonte2 + ", " +
-                            to_string(instrucoes[i].offsetImediato) + "(" +
-                            instrucoes[i].regFonte1 + ")";
-            } else if (instrucoes[i].tipoInstrucao == TiposInstrucao::BNE) {
-                instrStr += instrucoes[i].regFonte1 + ", " +
-                            instrucoes[i].regFonte2 + ", " +
-                            to_string(instrucoes[i].offsetImediato);
-            } else {
-                instrStr += instrucoes[i].regDestino + ", " +
-                            instrucoes[i].regFonte1 + ", " +
-                            instrucoes[i].regFonte2;
-            }
-            cout << left << setw(24) << instrStr;
+            string instrStr = to_string(i) + ". " + descreverInstrucao(instrucoes[i]);
+            tela.saida << left << setw(24) << instrStr;
 
             irPara(27, offset + y + 2);
-            cout << "|" << right << setw(7)
-                 << (instrucoes[i].status.emitido == -1 ? "" : to_string(instrucoes[i].status.emitido))
-                 << "|" << setw(7)
-                 << (instrucoes[i].status.inicioExecucao == -1 ? "" : to_string(instrucoes[i].status.inicioExecucao))
-                 << "|" << setw(7)
-                 << (instrucoes[i].status.fimExecucao == -1 ? "" : to_string(instrucoes[i].status.fimExecucao))
-                 << "|" << setw(9)
-                 << (instrucoes[i].status.escritaResultado == -1 ? "" : to_string(instrucoes[i].status.escritaResultado))
-                 << "|";
+            const StatusInstrucao& st = q.status[i];
+            tela.saida << "|" << right << setw(7)
+                       << (st.emitido == -1 ? "" : to_string(st.emitido))
+                       << "|" << setw(7)
+                       << (st.inicioExecucao == -1 ? "" : to_string(st.inicioExecucao))
+                       << "|" << setw(7)
+                       << (st.fimExecucao == -1 ? "" : to_string(st.fimExecucao))
+                       << "|" << setw(9)
+                       << (st.escritaResultado == -1 ? "" : to_string(st.escritaResultado))
+                       << "|";
 
             offset++;
             irPara(27, offset + y + 2);
-            cout << "|_______|_______|_______|_________|";
+            tela.saida << "|_______|_______|_______|_________|";
             offset++;
         }
 
         int yLS = 2;
         irPara(70, yLS);
-        cout << "Load/Store Buffers: Ocupado Endereco Qbase Vbase Qval Vval Rest.";
+        tela.saida << "Load/Store Buffers: Ocupado Endereco Qbase Vbase Qval Vval Rest.";
         yLS++;
-        irPara(72, yLS); cout << "__________________________________________________________";
+        irPara(72, yLS); tela.saida << "__________________________________________________________";
 
         for (int i = 0; i < numBuffersCarregamento; i++) {
             yLS++;
             irPara(70, yLS);
-            BufferLoad& lb = buffersCarregamento[i];
-            cout << right << setw(8) << lb.nome;
-            cout << " |" << setw(7) << (lb.ocupado ? "Sim" : "Nao");
-            string endStr = lb.ocupado && lb.origemBase.empty()
+            const BufferLoad& lb = q.loads[i];
+            tela.saida << right << setw(8) << lb.nome;
+            tela.saida << " |" << setw(7) << (lb.ocupado ? "Sim" : "Nao");
+            string endStr = lb.ocupado && lb.origemBase == SEM_UNIDADE
                 ? to_string(lb.baseVal) + "+" + to_string(lb.instrucao->offsetImediato)
                 : "";
-            cout << "|" << setw(9) << endStr;
-            cout << "|" << setw(6) << lb.origemBase;
-            cout << "|" << setw(6) << (lb.origemBase.empty() && lb.ocupado ? to_string(lb.baseVal) : "");
-            cout << "|" << setw(6) << "";
-            cout << "|" << setw(6) << (lb.resultReady ? to_string(lb.resultado) : "");
-            cout << "|" << setw(5) << (lb.ocupado ? to_string(max(lb.ciclosRestantes,0)) : "") << "|";
+            tela.saida << "|" << setw(9) << endStr;
+            tela.saida << "|" << setw(6) << nomeTag(lb.origemBase);
+            tela.saida << "|" << setw(6) << (lb.origemBase == SEM_UNIDADE && lb.ocupado ? to_string(lb.baseVal) : "");
+            tela.saida << "|" << setw(6) << "";
+            tela.saida << "|" << setw(6) << (lb.resultReady ? to_string(lb.resultado) : "");
+            tela.saida << "|" << setw(5) << (lb.ocupado ? to_string(max(lb.ciclosRestantes,0)) : "") << "|";
             yLS++;
-            irPara(78, yLS); cout << "|_______|_________|______|______|______|______|_____|";
+            irPara(78, yLS); tela.saida << "|_______|_________|______|______|______|______|_____|";
         }
         for (int i = 0; i < numBuffersArmazenamento; i++) {
             yLS++;
             irPara(70, yLS);
-            BufferStore& sb = buffersArmazenamento[i];
-            cout << right << setw(8) << sb.nome;
-            cout << " |" << setw(7) << (sb.ocupado ? "Sim" : "Nao");
-            string endStr = sb.ocupado && sb.origemBase.empty()
+            const BufferStore& sb = q.stores[i];
+            tela.saida << right << setw(8) << sb.nome;
+            tela.saida << " |" << setw(7) << (sb.ocupado ? "Sim" : "Nao");
+            string endStr = sb.ocupado && sb.origemBase == SEM_UNIDADE
                 ? to_string(sb.baseVal) + "+" + to_string(sb.instrucao->offsetImediato)
                 : "";
-            cout << "|" << setw(9) << endStr;
-            cout << "|" << setw(6) << sb.origemBase;
-            cout << "|" << setw(6) << (sb.origemBase.empty() && sb.ocupado ? to_string(sb.baseVal) : "");
-            cout << "|" << setw(6) << sb.origemVal;
-            cout << "|" << setw(6) << (sb.origemVal.empty() && sb.ocupado ? to_string(sb.value) : "");
-            cout << "|" << setw(5) << (sb.ocupado ? to_string(max(sb.ciclosRestantes,0)) : "") << "|";
+            tela.saida << "|" << setw(9) << endStr;
+            tela.saida << "|" << setw(6) << nomeTag(sb.origemBase);
+            tela.saida << "|" << setw(6) << (sb.origemBase == SEM_UNIDADE && sb.ocupado ? to_string(sb.baseVal) : "");
+            tela.saida << "|" << setw(6) << nomeTag(sb.origemVal);
+            tela.saida << "|" << setw(6) << (sb.origemVal == SEM_UNIDADE && sb.ocupado ? to_string(sb.value) : "");
+            tela.saida << "|" << setw(5) << (sb.ocupado ? to_string(max(sb.ciclosRestantes,0)) : "") << "|";
             yLS++;
-            irPara(78, yLS); cout << "|_______|_________|______|______|______|______|_____|";
+            irPara(78, yLS); tela.saida << "|_______|_________|______|______|______|______|_____|";
         }
 
         int yRegs = (offset + y + 2 > yLS ? offset + y + 2 : yLS) + 3;
-        irPara(90, yRegs); cout << "Registradores (Valores):";
-        irPara(90, ++yRegs); cout << " Nome  Valor";
-        irPara(90, ++yRegs); cout << "____________";
+        irPara(90, yRegs); tela.saida << "Registradores (Valores):";
+        irPara(90, ++yRegs); tela.saida << " Nome  Valor";
+        irPara(90, ++yRegs); tela.saida << "____________";
 
-        for (size_t i = 0; i < registradores.size(); ++i) {
+        for (size_t i = 0; i < q.registradores.size(); ++i) {
             yRegs++;
             irPara(90, yRegs);
-            cout << "| " << left << setw(4) << registradores[i].nome
-                 << "| " << right << setw(5) << registradores[i].valor << "|";
+            tela.saida << "| " << left << setw(4) << q.registradores[i].nome
+                       << "| " << right << setw(5) << q.registradores[i].valor << "|";
         }
-        if (!registradores.empty()) {
+        if (!q.registradores.empty()) {
             yRegs++;
-            irPara(90, yRegs); cout << "|_____|_______|";
+            irPara(90, yRegs); tela.saida << "|_____|_______|";
         }
 
         yRegs++;
-        irPara(90, ++yRegs); cout << "Memoria";
-        irPara(90, ++yRegs); cout << " End.  Valor";
-        irPara(90, ++yRegs); cout << "____________";
-        for (const auto& m : memoria) {
+        irPara(90, ++yRegs); tela.saida << "Memoria";
+        irPara(90, ++yRegs); tela.saida << " End.  Valor";
+        irPara(90, ++yRegs); tela.saida << "____________";
+        for (const auto& m : q.memoria) {
             yRegs++;
             irPara(90, yRegs);
-            cout << "| " << left << setw(4) << m.nome
-                 << "| " << right << setw(5) << m.valor << "|";
+            tela.saida << "| " << left << setw(4) << m.first
+                       << "| " << right << setw(5) << m.second << "|";
         }
-        if (!memoria.empty()) {
+        if (!q.memoria.empty()) {
             yRegs++;
-            irPara(90, yRegs); cout << "|____|_______|";
+            irPara(90, yRegs); tela.saida << "|____|_______|";
+        }
+        if (q.celulasTocadas > q.memoria.size()) {
+            irPara(90, ++yRegs);
+            tela.saida << "+" << q.celulasTocadas - q.memoria.size() << " celula(s)";
         }
 
         int yER = (yRegs > yLS ? yRegs : yLS) + 3;
-        irPara(4, yER); cout << "Estacoes de Reserva (ERs):";
+        irPara(4, yER); tela.saida << "Estacoes de Reserva (ERs):";
         yER++;
-        irPara(21, yER); cout << " Nome  Ocup  Op  Vj   Vk   Qj      Qk      Rest.";
+        irPara(21, yER); tela.saida << " Nome  Ocup  Op  Vj   Vk   Qj      Qk      Rest.";
         yER++;
-        irPara(28, yER); cout << "_________________________________________________";
+        irPara(28, yER); tela.saida << "_________________________________________________";
 
         for (int i = 0; i < numEstacoesAddSub; i++) {
-            EstacaoReserva& er = estacoesAddSub[i];
+            const EstacaoReserva& er = q.estacoesAddSub[i];
             yER++;
             irPara(19, yER);
-            cout << right << setw(6) << er.nome
-                 << " |" << setw(4) << (er.ocupado ? "Sim" : "Nao")
-                 << "|" << setw(4) << er.tipoInstrucao
-                 << "|" << setw(4) << (er.origemJ.empty() && er.ocupado ? to_string(er.valorJ) : "")
-                 << "|" << setw(4) << (er.origemK.empty() && er.ocupado ? to_string(er.valorK) : "")
-                 << "|" << setw(7) << er.origemJ
-                 << "|" << setw(7) << er.origemK
-                 << "|" << setw(5) << (er.ocupado ? to_string(max(er.ciclosRestantes,0)) : "") << "|";
+            tela.saida << right << setw(6) << er.nome
+                       << " |" << setw(4) << (er.ocupado ? "Sim" : "Nao")
+                       << "|" << setw(4) << (er.ocupado ? NOMES_TIPOS_INSTRUCAO[er.tipoInstrucao] : "")
+                       << "|" << setw(4) << (er.origemJ == SEM_UNIDADE && er.ocupado ? to_string(er.valorJ) : "")
+                       << "|" << setw(4) << (er.origemK == SEM_UNIDADE && er.ocupado ? to_string(er.valorK) : "")
+                       << "|" << setw(7) << nomeTag(er.origemJ)
+                       << "|" << setw(7) << nomeTag(er.origemK)
+                       << "|" << setw(5) << (er.ocupado ? to_string(max(er.ciclosRestantes,0)) : "") << "|";
             yER++;
-            irPara(25, yER); cout << "|____|____|____|____|_______|_______|_____|";
+            irPara(25, yER); tela.saida << "|____|____|____|____|_______|_______|_____|";
         }
         for (int i = 0; i < numEstacoesMultDiv; i++) {
-            EstacaoReserva& er = estacoesMultDiv[i];
+            const EstacaoReserva& er = q.estacoesMultDiv[i];
             yER++;
             irPara(19, yER);
-            cout << right << setw(6) << er.nome
-                 << " |" << setw(4) << (er.ocupado ? "Sim" : "Nao")
-                 << "|" << setw(4) << er.tipoInstrucao
-                 << "|" << setw(4) << (er.origemJ.empty() && er.ocupado ? to_string(er.valorJ) : "")
-                 << "|" << setw(4) << (er.origemK.empty() && er.ocupado ? to_string(er.valorK) : "")
-                 << "|" << setw(7) << er.origemJ
-                 << "|" << setw(7) << er.origemK
-                 << "|" << setw(5) << (er.ocupado ? to_string(max(er.ciclosRestantes,0)) : "") << "|";
+            tela.saida << right << setw(6) << er.nome
+                       << " |" << setw(4) << (er.ocupado ? "Sim" : "Nao")
+                       << "|" << setw(4) << (er.ocupado ? NOMES_TIPOS_INSTRUCAO[er.tipoInstrucao] : "")
+                       << "|" << setw(4) << (er.origemJ == SEM_UNIDADE && er.ocupado ? to_string(er.valorJ) : "")
+                       << "|" << setw(4) << (er.origemK == SEM_UNIDADE && er.ocupado ? to_string(er.valorK) : "")
+                       << "|" << setw(7) << nomeTag(er.origemJ)
+                       << "|" << setw(7) << nomeTag(er.origemK)
+                       << "|" << setw(5) << (er.ocupado ? to_string(max(er.ciclosRestantes,0)) : "") << "|";
             yER++;
-            irPara(25, yER); cout << "|____|____|____|____|_______|_______|_____|";
+            irPara(25, yER); tela.saida << "|____|____|____|____|_______|_______|_____|";
         }
 
         int yStatusReg = yER + 3;
-        irPara(20, yStatusReg); cout << "Estado dos Registradores (Unidade Escritora - Q.i):";
+        irPara(20, yStatusReg); tela.saida << "Estado dos Registradores (Unidade Escritora - Q.i):";
         yStatusReg++;
 
         int xPos = 20;
         for (int i = 0; i < numTotalRegistradores; i++) {
             irPara(xPos, yStatusReg);
-            cout << right << setw(5) << estadoRegistradores[i].nomeRegistrador;
-            irPara(xPos, yStatusReg + 1); cout << "______";
+            tela.saida << right << setw(5) << q.estadoRegistradores[i].nomeRegistrador;
+            irPara(xPos, yStatusReg + 1); tela.saida << "______";
             irPara(xPos, yStatusReg + 2);
-            cout << "|" << setw(4) << estadoRegistradores[i].unidadeEscritora << "|";
-            irPara(xPos, yStatusReg + 3); cout << "|______|";
+            if (tamanhoROB > 0) {
+                int e = q.estadoRegistradores[i].entradaROB;
+                tela.saida << "|" << setw(5) << (e == -1 ? "" : "ROB" + to_string(e)) << "|";
+            } else {
+                tela.saida << "|" << setw(4) << nomeTag(q.estadoRegistradores[i].unidadeEscritora) << "|";
+            }
+            irPara(xPos, yStatusReg + 3); tela.saida << "|______|";
             xPos += 8;
         }
 
         irPara(2, yStatusReg + 5);
-        cout << "\n\nEventos do Ciclo " << cicloAtual - 1 << " (Log): \n"
-             << logEventos;
+        tela.saida << "\n\nFila de Instrucoes (largura " << larguraEmissao << "):";
+        for (int indice : q.fila) tela.saida << " " << indice;
+        for (int g = 0; g < NUM_GRUPOS_FU; g++)
+            if (unidades[g].quantidade > 0)
+                tela.saida << "\nUnidades " << unidades[g].nome << " livres: "
+                           << q.livres[g] << "/" << unidades[g].quantidade;
+        if (tamanhoROB > 0) mostrarROB(q);
+        tela.saida << "\n\nEventos do Ciclo " << q.ciclo - 1 << " (Log): \n"
+                   << q.logEventos;
+    }
+
+    // Copia para 'q' o estado exibido no ciclo atual (reaproveita a capacidade
+    // dos vetores de q, que a simulação reutiliza ciclo a ciclo)
+    void capturar(Instantaneo& q, bool fim) const {
+        q.ciclo = cicloAtual;
+        q.fim = fim;
+        q.status.resize(numInstrucoes);
+        for (int i = 0; i < numInstrucoes; i++) q.status[i] = registroVisivel(i);
+        q.loads.assign(buffersCarregamento, buffersCarregamento + numBuffersCarregamento);
+        q.stores.assign(buffersArmazenamento, buffersArmazenamento + numBuffersArmazenamento);
+        q.estacoesAddSub.assign(estacoesAddSub, estacoesAddSub + numEstacoesAddSub);
+        q.estacoesMultDiv.assign(estacoesMultDiv, estacoesMultDiv + numEstacoesMultDiv);
+        q.registradores = registradores;
+        q.memoria = memoria.celulasTocadas(CELULAS_NA_TELA);
+        q.celulasTocadas = q.memoria.size() < CELULAS_NA_TELA ? q.memoria.size() : memoria.numTocadas();
+        q.estadoRegistradores.assign(estadoRegistradores, estadoRegistradores + numTotalRegistradores);
+        q.fila.clear();
+        for (const InstrucaoBuscada& b : filaInstrucoes) q.fila.push_back(b.indice);
+        for (int g = 0; g < NUM_GRUPOS_FU; g++) q.livres[g] = unidades[g].livresEm(cicloAtual);
+        q.robOcupadas = robOcupadas;
+        q.rob.clear();
+        for (int k = 0; k < robOcupadas; k++) {
+            int e = (robCabeca + k) % tamanhoROB;
+            const EntradaROB& ent = rob[e];
+            const char* estado = ent.pronto ? "Pronta"
+                : ent.status->inicioExecucao != -1 ? "Executando" : "Emitida";
+            q.rob.push_back({e, ent.indiceInstrucao, estado, ent.destReg, ent.pronto, ent.valor});
+        }
+        q.logEventos = logEventos;
+    }
+
+    // Monta o quadro de um ciclo e envia ao terminal só o que mudou
+    void desenharQuadro(const Instantaneo& q, const string& titulo, const string& rodape) const {
+        irPara(0, 0);
+        tela.saida << "Ciclo Atual: " << q.ciclo << titulo;
+        mostrarEstado(q);
+        tela.saida << rodape;
+        tela.apresentar();
+    }
+
+    void desenharFim(const Instantaneo& q) const {
+        desenharQuadro(q, " (FIM DA SIMULACAO)",
+                       "\nSimulacao concluida no Ciclo " + to_string(q.ciclo) + ".\n");
+    }
+
+    // Avança um ciclo: commit, write-back, execução, busca e emissão
+    void executarCiclo() {
+        logEventos.clear();
+        enderecosEscritos.clear();
+        classeConcluida = -1;
+
+        if (tamanhoROB > 0) confirmarROB();
+        escreverResultado_CDB();
+        if (tamanhoROB == 0) escreverResultado_STOREs();
+        executar();
+
+        if (branchResolved) {
+            if (branchTaken)
+                proxBusca = branchTarget;
+            else
+                proxBusca = branchIssuedIndex + 1;
+
+            buscaBloqueada = false;
+            branchPending = false;
+            branchResolved = false;
+            branchTaken = false;
+            branchTarget = -1;
+            branchIssuedIndex = -1;
+        }
+
+        buscarInstrucoes();
+        emitirCiclo();
+        contabilizarCiclos(cicloAtual, 1, classeConcluida);
     }
 
     void Simular() {
-        int proxIndiceInstrucao = 0;
-        cicloAtual = 1;
+        if (cicloAtual == 0) cicloAtual = 1; // restaurado de checkpoint: segue do ciclo gravado
+
+        if (modoFuncional) {
+            executarFuncional();
+            return;
+        }
+        if (periodoAmostragem > 0) {
+            simularAmostragem();
+            return;
+        }
+        if (modoBatch) {
+            avancar(INT_MAX);
+            if (imprimirResumo) mostrarResumo();
+            return;
+        }
+
+        Instantaneo quadro;
+        if (avancarAte > cicloAtual && !avancar(avancarAte)) {
+            capturar(quadro, true);
+            desenharFim(quadro);
+            return;
+        }
+        if (reproducaoAutomatica) {
+            reproduzir();
+            return;
+        }
+
+        depurar();
+    }
 
+    // Modo interativo: console de comandos (ver AJUDA_DEPURADOR). Cada ciclo
+    // simulado guarda em historicoEstados o núcleo do estado inicial e o que
+    // suas escritas mudaram, de onde os comandos que voltam restauram o
+    // estado sem resimular.
+    void depurar() {
+        static const char* const AJUDA_DEPURADOR =
+            "Comandos:\n"
+            "  ENTER ou p [n]      avanca 1 (ou n) ciclos\n"
+            "  c                   continua ate um breakpoint ou o fim\n"
+            "  a <ciclo>           vai ao ciclo (para tras ou para frente)\n"
+            "  v [n]               volta 1 (ou n) ciclos\n"
+            "  b emite <i>         para quando a instrucao i emitir\n"
+            "  b conclui <i>       para quando a instrucao i terminar a execucao\n"
+            "  b escreve <i>       para quando a instrucao i escrever o resultado\n"
+            "  b reg <Fk>          para quando o Qi de Fk mudar\n"
+            "  b mem <endereco>    para quando o endereco for escrito\n"
+            "  l                   lista os breakpoints\n"
+            "  d <n>               remove o breakpoint n\n"
+            "  q                   encerra a simulacao\n";
+        Instantaneo quadro;
+        string mensagem;
+        bool fim = false;
         while (true) {
-            irPara(0, 0);
-            cout << "Ciclo Atual: " << cicloAtual;
-            mostrarEstado();
+            capturar(quadro, fim);
+            if (fim)
+                desenharQuadro(quadro, " (FIM DA SIMULACAO)",
+                               "\nSimulacao concluida no Ciclo " + to_string(cicloAtual) + ".\n" + mensagem +
+                               "\nComando (ENTER encerra, v volta, ? ajuda): ");
+            else
+                desenharQuadro(quadro, "", "\n\n" + mensagem + "\n\nComando (ENTER = proximo ciclo, ? = ajuda): ");
+            mensagem.clear();
+
+            string linha, comando;
+            if (!getline(cin, linha)) linha.clear(); // sem entrada: como ENTER
+            istringstream in(linha);
+            in >> comando;
+            string arg1, arg2;
+            in >> arg1 >> arg2;
+            int n = 1;
+            bool temNumero = !arg1.empty() && converterInteiro(arg1, n);
+
+            if (comando == "q") break;
+            if (comando == "?" || comando == "h") {
+                mensagem = AJUDA_DEPURADOR;
+            } else if (comando == "a" && temNumero && n >= 1 && n < cicloAtual + (fim ? 1 : 0)) {
+                mensagem = voltarAoCiclo(n, fim);
+                fim = fim && !mensagem.empty();
+            } else if (comando.empty() || comando == "p" || comando == "c" || comando == "a") {
+                if (fim) {
+                    if (comando.empty()) break;
+                    mensagem = "A simulacao ja terminou.\n";
+                    continue;
+                }
+                int ate = comando == "c" ? INT_MAX : cicloAtual + 1;
+                if (comando == "p" && !arg1.empty()) {
+                    if (!temNumero || n < 1) { mensagem = "Numero de ciclos invalido: " + arg1 + "\n"; continue; }
+                    ate = (int)min((long long)INT_MAX, (long long)cicloAtual + n);
+                }
+                if (comando == "a") {
+                    if (!temNumero || n < 1) { mensagem = "Uso: a <ciclo>\n"; continue; }
+                    ate = n;
+                }
+                fim = avancarDepurando(ate, mensagem);
+            } else if (comando == "v") {
+                if (!arg1.empty() && (!temNumero || n < 1)) { mensagem = "Numero de ciclos invalido: " + arg1 + "\n"; continue; }
+                // No fim, o estado é o do fim do último ciclo: voltar 1 vai ao início dele
+                mensagem = voltarAoCiclo(cicloAtual - n + (fim ? 1 : 0), fim);
+                fim = fim && !mensagem.empty();
+            } else if (comando == "b") {
+                mensagem = criarBreakpoint(arg1, arg2);
+            } else if (comando == "l") {
+                mensagem = breakpoints.empty() ? "Nenhum breakpoint.\n" : "Breakpoints:\n";
+                for (size_t k = 0; k < breakpoints.size(); k++)
+                    mensagem += "  " + to_string(k + 1) + ". " + descreverBreakpoint(breakpoints[k]) + "\n";
+            } else if (comando == "d") {
+                if (!temNumero || n < 1 || n > (int)breakpoints.size()) {
+                    mensagem = "Breakpoint inexistente: " + arg1 + "\n";
+                } else {
+                    breakpoints.erase(breakpoints.begin() + (n - 1));
+                    mensagem = "Breakpoint " + to_string(n) + " removido.\n";
+                }
+            } else {
+                mensagem = "Comando desconhecido: " + comando + " (? mostra a ajuda)\n";
+            }
+        }
+    }
 
-            cout << "\n\n\n\nPressione ENTER para o proximo ciclo: ";
-            cin.sync();
-            cin.get();
+    // Núcleo do estado para o histórico do depurador (ver HistoricoEstados),
+    // em 'c', reaproveitado de um ciclo para o outro
+    void serializarNucleo(Checkpoint& c) {
+        c.dados.clear();
+        c.secoes.clear();
+        c.soNucleo = true;
+        transferirEstado(c);
+    }
 
-            logEventos.clear();
+    void restaurarNucleo(const string& nucleo) {
+        Checkpoint c;
+        c.gravando = false;
+        c.soNucleo = true;
+        c.dados = nucleo;
+        transferirEstado(c);
+    }
 
-            escreverResultado_CDB_unico();
-            escreverResultado_STOREs();
-            executar();
+    // Liga (ou desliga, com nullptr) a anotação das escritas do ciclo no
+    // registro de desfazer
+    void registrarEscritas(RegistroEscritas* registro) {
+        escritas = registro;
+        memoria.escritas = registro;
+        preditor.escritas = registro;
+        preditorMem.escritas = registro;
+        for (Cache& n : caches.niveis) n.escritas = registro;
+        caches.prefetcher.escritas = registro;
+    }
 
-            if (branchResolved) {
-                if (branchTaken)
-                    proxIndiceInstrucao = branchTarget;
-                else
-                    proxIndiceInstrucao = branchIssuedIndex + 1;
+    // Simula até o início do ciclo 'ate', parando antes se um breakpoint
+    // disparar; devolve verdadeiro se a simulação terminou
+    bool avancarDepurando(int ate, string& mensagem) {
+        vector<int> qiAntes(numTotalRegistradores);
+        Checkpoint nucleo;
+        RegistroEscritas registro;
+        while (cicloAtual < ate) {
+            bool novo = !historicoEstados.contem(cicloAtual);
+            if (novo) {
+                serializarNucleo(nucleo);
+                historicoEstados.guardar(cicloAtual, nucleo.dados, nucleo.secoes);
+            }
+            checkpointPeriodico();
+            for (int r = 0; r < numTotalRegistradores; r++) qiAntes[r] = qiRegistrador(r);
+            if (novo) registrarEscritas(&registro);
+            executarCiclo();
+            if (novo) {
+                registrarEscritas(nullptr);
+                historicoEstados.concluir(move(registro.dados));
+                registro.dados.clear();
+            }
+            mensagem = verificarBreakpoints(qiAntes);
+            if (!haTrabalhoPendente()) return true;
+            cicloAtual++;
+            if (!mensagem.empty()) break;
+        }
+        return false;
+    }
 
-                branchPending = false;
-                branchResolved = false;
-                branchTaken = false;
-                branchTarget = -1;
-                branchIssuedIndex = -1;
-            }
-
-            int resIssue = -1;
-            if (!branchPending && proxIndiceInstrucao < numInstrucoes)
-                resIssue = emitirInstrucao(proxIndiceInstrucao);
-            if (resIssue != -1 && resIssue != -2) proxIndiceInstrucao++;
-
-            if (!haTrabalhoPendente(proxIndiceInstrucao)) {
-                system("cls");
-                irPara(0, 0);
-                cout << "Ciclo Atual: " << cicloAtual << " (FIM DA SIMULACAO)";
-                mostrarEstado();
-                cout << "\nSimulacao concluida no Ciclo " << cicloAtual << ".\n";
+    // Restaura o estado do início de 'ciclo' a partir do histórico ('fim': o
+    // estado atual é o do fim do ciclo atual); devolve uma mensagem de erro
+    // se o ciclo não foi visto
+    string voltarAoCiclo(int ciclo, bool fim) {
+        if (!historicoEstados.contem(ciclo))
+            return "Ciclo " + to_string(ciclo) + " fora do historico (ciclos " +
+                   to_string(historicoEstados.primeiro) + " a " + to_string(historicoEstados.ultimo()) + ").\n";
+        historicoEstados.desfazer(ciclo, cicloAtual + (fim ? 1 : 0));
+        restaurarNucleo(historicoEstados.reconstruir(ciclo));
+        return "";
+    }
+
+    int qiRegistrador(int r) const {
+        return tamanhoROB > 0 ? estadoRegistradores[r].entradaROB : estadoRegistradores[r].unidadeEscritora;
+    }
+
+    // Alguma instância da instrução 'i' teve no ciclo atual o evento do breakpoint
+    bool eventoInstrucao(int i, int tipo) const {
+        auto marcou = [&](const StatusInstrucao* st) {
+            if (!st) return false;
+            int ciclo = tipo == BP_EMISSAO ? st->emitido
+                      : tipo == BP_CONCLUSAO ? st->fimExecucao : st->escritaResultado;
+            return ciclo == cicloAtual;
+        };
+        const Instrucao* instr = &instrucoes[i];
+        if (marcou(&statusInstrucoes[i])) return true;
+        for (int k = 0; k < numBuffersCarregamento; k++) {
+            const BufferLoad& lb = buffersCarregamento[k];
+            if (lb.ocupado && lb.instrucao == instr && marcou(lb.status)) return true;
+        }
+        for (int k = 0; k < numBuffersArmazenamento; k++) {
+            const BufferStore& sb = buffersArmazenamento[k];
+            if (sb.ocupado && sb.instrucao == instr && marcou(sb.status)) return true;
+        }
+        for (int g = 0; g < 2; g++) {
+            const EstacaoReserva* ers = g == 0 ? estacoesAddSub : estacoesMultDiv;
+            int n = g == 0 ? numEstacoesAddSub : numEstacoesMultDiv;
+            for (int k = 0; k < n; k++)
+                if (ers[k].ocupado && ers[k].instrucao == instr && marcou(ers[k].status)) return true;
+        }
+        for (int k = 0; k < robOcupadas; k++) {
+            const EntradaROB& ent = rob[(robCabeca + k) % tamanhoROB];
+            if (ent.indiceInstrucao == i && marcou(ent.status)) return true;
+        }
+        return false;
+    }
+
+    // Breakpoints disparados pelo ciclo que acabou de ser simulado
+    string verificarBreakpoints(const vector<int>& qiAntes) const {
+        string s;
+        for (size_t k = 0; k < breakpoints.size(); k++) {
+            const Breakpoint& b = breakpoints[k];
+            bool disparou;
+            if (b.tipo == BP_REGISTRADOR)
+                disparou = qiAntes[b.alvo] != qiRegistrador(b.alvo);
+            else if (b.tipo == BP_MEMORIA)
+                disparou = find(enderecosEscritos.begin(), enderecosEscritos.end(), b.alvo) != enderecosEscritos.end();
+            else
+                disparou = eventoInstrucao(b.alvo, b.tipo);
+            if (disparou)
+                s += "Breakpoint " + to_string(k + 1) + ": " + descreverBreakpoint(b) +
+                     " (ciclo " + to_string(cicloAtual) + ").\n";
+        }
+        return s;
+    }
+
+    string descreverBreakpoint(const Breakpoint& b) const {
+        switch (b.tipo) {
+        case BP_EMISSAO: return "instrucao " + to_string(b.alvo) + " emitida";
+        case BP_CONCLUSAO: return "instrucao " + to_string(b.alvo) + " terminou a execucao";
+        case BP_ESCRITA: return "instrucao " + to_string(b.alvo) + " escreveu o resultado";
+        case BP_REGISTRADOR: return "Qi de F" + to_string(b.alvo) + " mudou";
+        default: return "endereco " + to_string(b.alvo) + " escrito";
+        }
+    }
+
+    // Comando "b <tipo> <alvo>"; devolve a mensagem para o usuário
+    string criarBreakpoint(const string& tipo, const string& alvo) {
+        Breakpoint b;
+        if (tipo == "emite" || tipo == "conclui" || tipo == "escreve") {
+            b.tipo = tipo == "emite" ? BP_EMISSAO : tipo == "conclui" ? BP_CONCLUSAO : BP_ESCRITA;
+            if (!converterInteiro(alvo, b.alvo) || b.alvo < 0 || b.alvo >= numInstrucoes)
+                return "Instrucao invalida: " + alvo + "\n";
+        } else if (tipo == "reg") {
+            b.tipo = BP_REGISTRADOR;
+            b.alvo = regIndex(alvo);
+            if (b.alvo < 0) return "Registrador invalido: " + alvo + "\n";
+        } else if (tipo == "mem") {
+            b.tipo = BP_MEMORIA;
+            if (!converterInteiro(alvo, b.alvo)) return "Endereco invalido: " + alvo + "\n";
+        } else {
+            return "Uso: b emite|conclui|escreve <instrucao>, b reg <Fk> ou b mem <endereco>\n";
+        }
+        breakpoints.push_back(b);
+        return "Breakpoint " + to_string(breakpoints.size()) + ": " + descreverBreakpoint(b) + ".\n";
+    }
+
+    // Simula sem exibir nada até o início do ciclo 'ate' (modo batch e avanço
+    // rápido), ou até o ciclo em que instrucoesConcluidas chega a
+    // 'concluidasAte' (amostragem); devolve falso se a simulação terminou
+    // antes. Os saltos de ciclos ociosos param em 'ate' e nos ciclos de checkpoint.
+    // Só aqui se salta: o depurador e o --auto continuam ciclo a ciclo, porque
+    // cada ciclo é desenhado, confere os breakpoints e entra no histórico, e
+    // o --auto mede o ritmo em ciclos por segundo.
+    bool avancar(int ate, long long concluidasAte = LLONG_MAX) {
+        bool exibir = !modoBatch;
+        modoBatch = true; // sem log de eventos
+        bool pendente = true;
+        while (cicloAtual < ate) {
+            checkpointPeriodico();
+            executarCiclo();
+
+            if (!haTrabalhoPendente()) {
+                pendente = false;
+                break;
+            }
+
+            if (saltarCiclosOciosos) {
+                int k = min(ciclosOciososAFrente(), ate - cicloAtual - 1);
+                if (intervaloCheckpoint > 0)
+                    k = min(k, intervaloCheckpoint - cicloAtual % intervaloCheckpoint - 1);
+                if (k > 0) {
+                    contabilizarCiclos(cicloAtual + 1, k, -1);
+                    avancarCiclosOciosos(k);
+                }
+            }
+
+            cicloAtual++;
+            if (instrucoesConcluidas >= concluidasAte) break;
+        }
+        modoBatch = !exibir;
+        return pendente;
+    }
+
+    // Checkpoint periódico no início dos ciclos múltiplos de intervaloCheckpoint
+    void checkpointPeriodico() {
+        if (intervaloCheckpoint <= 0 || cicloAtual % intervaloCheckpoint != 0) return;
+        gravarCheckpoint(prefixoCheckpoint + "." + to_string(cicloAtual) + ".ckpt");
+    }
+
+    // Emulação funcional: executa até 'limite' instruções a partir de
+    // proxBusca só no nível da arquitetura (registradores e memória), sem
+    // unidades, ROB nem tempo, e devolve quantas executou. O pipeline deve
+    // estar vazio. Com 'aquecer', LOADs e STOREs passam pelas etiquetas das
+    // caches e os desvios treinam o preditor, como na execução detalhada.
+    long long emularFuncional(long long limite, bool aquecer) {
+        vector<int> r(numTotalRegistradores);
+        for (int k = 0; k < numTotalRegistradores; k++) r[k] = registradores[k].valor;
+        bool aquecerCaches = aquecer && caches.ativa();
+        bool treinarPreditor = aquecer && tamanhoROB > 0;
+
+        const Instrucao* programa = instrucoes;
+        int pc = proxBusca;
+        long long executadas = 0;
+        while (executadas < limite && pc < numInstrucoes) {
+            const Instrucao& instr = programa[pc];
+            int proximo = pc + 1;
+            switch (instr.tipoInstrucao) {
+            case TiposInstrucao::SOMA: r[instr.regDestino] = r[instr.regFonte1] + r[instr.regFonte2]; break;
+            case TiposInstrucao::SUBT: r[instr.regDestino] = r[instr.regFonte1] - r[instr.regFonte2]; break;
+            case TiposInstrucao::MULT: r[instr.regDestino] = r[instr.regFonte1] * r[instr.regFonte2]; break;
+            case TiposInstrucao::DIVI:
+                r[instr.regDestino] = r[instr.regFonte2] == 0 ? 0 : r[instr.regFonte1] / r[instr.regFonte2];
+                break;
+            case TiposInstrucao::SOMA_IMED: r[instr.regDestino] = r[instr.regFonte1] + instr.offsetImediato; break;
+            case TiposInstrucao::SUBT_IMED: r[instr.regDestino] = r[instr.regFonte1] - instr.offsetImediato; break;
+            case TiposInstrucao::MULT_IMED: r[instr.regDestino] = r[instr.regFonte1] * instr.offsetImediato; break;
+            case TiposInstrucao::DIVI_IMED:
+                r[instr.regDestino] = instr.offsetImediato == 0 ? 0 : r[instr.regFonte1] / instr.offsetImediato;
+                break;
+            case TiposInstrucao::CARREGA: {
+                int endereco = r[instr.regFonte1] + instr.offsetImediato;
+                if (aquecerCaches) caches.aquecer(endereco, false);
+                r[instr.regFonte2] = memoria.ler(endereco);
+                break;
+            }
+            case TiposInstrucao::ARMAZENA: {
+                int endereco = r[instr.regFonte1] + instr.offsetImediato;
+                if (aquecerCaches) caches.aquecer(endereco, true);
+                memoria.escrever(endereco, r[instr.regFonte2]);
+                break;
+            }
+            case TiposInstrucao::BNE:
+            case TiposInstrucao::BEQ: {
+                bool tomado = (r[instr.regFonte1] == r[instr.regFonte2]) == (instr.tipoInstrucao == TiposInstrucao::BEQ);
+                if (treinarPreditor) {
+                    preditor.atualizar(pc, preditor.historico, tomado);
+                    preditor.especular(tomado);
+                }
+                if (tomado) proximo = alvoDesvio(pc);
                 break;
             }
+            default: // NOP
+                break;
+            }
+            pc = proximo;
+            executadas++;
+        }
+
+        for (int k = 0; k < numTotalRegistradores; k++) registradores[k].valor = r[k];
+        proxBusca = pc;
+        return executadas;
+    }
+
+    // --funcional: executa o programa inteiro pela emulação funcional e
+    // mostra o estado final da arquitetura e a velocidade
+    void executarFuncional() {
+        auto inicio = chrono::steady_clock::now();
+        long long executadas = emularFuncional(LLONG_MAX, false);
+        double segundos = chrono::duration<double>(chrono::steady_clock::now() - inicio).count();
+
+        ostringstream out;
+        out << "Emulacao funcional concluida: " << executadas << " instrucoes em " << fixed
+            << setprecision(3) << segundos << " s (" << setprecision(1)
+            << (segundos > 0 ? executadas / segundos / 1e6 : 0.0) << " milhoes de instrucoes/s)\n";
+        out << "\nRegistradores:";
+        for (int r = 0; r < numTotalRegistradores; r++)
+            out << (r % 8 == 0 ? "\n " : "") << " " << registradores[r].nome << "=" << registradores[r].valor;
+        out << "\nCelulas de memoria escritas: " << memoria.celulasTocadas().size() << "\n";
+        cout << out.str();
+    }
+
+    // Valor crítico bicaudal de 95% da t de Student com 'graus' graus de liberdade
+    static double valorT95(long long graus) {
+        static const double TABELA[] = {
+            12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+            2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+            2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042
+        };
+        if (graus < 1) return 0.0;
+        if (graus <= 30) return TABELA[graus - 1];
+        return graus <= 60 ? 2.000 : graus <= 120 ? 1.980 : 1.960;
+    }
+
+    // --amostragem: amostragem sistemática. Cada período de periodoAmostragem
+    // instruções começa com emulação funcional (que aquece caches e preditor)
+    // e termina com aquecimentoAmostragem + janelaAmostragem instruções
+    // simuladas em detalhe, das quais só as da janela são medidas. Depois da
+    // janela a busca para e o pipeline esvazia, e a emulação segue do PC em
+    // que a busca parou. O CPI médio das janelas estima os ciclos do programa
+    // inteiro, com intervalo de confiança de 95%.
+    void simularAmostragem() {
+        auto inicio = chrono::steady_clock::now();
+        long long funcionais = 0, detalhadas = 0;
+        vector<double> cpis;
+        long long rapido = periodoAmostragem - aquecimentoAmostragem - janelaAmostragem;
+        while (true) {
+            long long n = emularFuncional(rapido, true);
+            funcionais += n;
+            if (n < rapido || proxBusca >= numInstrucoes) break; // fim do programa
+
+            long long antes = instrucoesConcluidas;
+            bool pendente = aquecimentoAmostragem == 0 || avancar(INT_MAX, antes + aquecimentoAmostragem);
+            int cicloJanela = cicloAtual;
+            long long inicioJanela = instrucoesConcluidas;
+            if (pendente) pendente = avancar(INT_MAX, inicioJanela + janelaAmostragem);
+            if (pendente) {
+                cpis.push_back((double)(cicloAtual - cicloJanela) / (instrucoesConcluidas - inicioJanela));
+                buscaSuspensa = true;
+                avancar(INT_MAX);
+                buscaSuspensa = false;
+                cicloAtual++;
+            }
+            detalhadas += instrucoesConcluidas - antes;
+            if (!pendente) break;
+        }
+        double segundos = chrono::duration<double>(chrono::steady_clock::now() - inicio).count();
+
+        long long total = funcionais + detalhadas;
+        ostringstream out;
+        out << fixed << setprecision(3);
+        out << "Simulacao por amostragem concluida.\n"
+            << "\nInstrucoes: " << total << " (" << funcionais << " funcionais, " << detalhadas << " detalhadas)"
+            << "\nPeriodo: " << periodoAmostragem << " instrucoes, janela " << janelaAmostragem
+            << ", aquecimento " << aquecimentoAmostragem
+            << "\nAmostras: " << cpis.size()
+            << "\nCiclos simulados em detalhe: " << cicloAtual - 1
+            << "\nTempo: " << segundos << " s (" << setprecision(0)
+            << (segundos > 0 ? total / segundos : 0.0) << " instrucoes/s)\n" << setprecision(3);
+        if (cpis.empty()) {
+            out << "\nNenhuma janela completa: use um periodo menor que o programa.\n";
+            cout << out.str();
+            return;
+        }
+
+        double soma = 0.0;
+        for (double c : cpis) soma += c;
+        double media = soma / cpis.size();
+        double variancia = 0.0;
+        for (double c : cpis) variancia += (c - media) * (c - media);
+        long long n = (long long)cpis.size();
+        double desvio = n > 1 ? sqrt(variancia / (n - 1)) : 0.0;
+        double meiaLargura = n > 1 ? valorT95(n - 1) * desvio / sqrt((double)n) : 0.0;
+
+        out << "\nCPI medio das janelas: " << media << " (desvio padrao " << desvio << ")"
+            << "\nIPC estimado: " << (media > 0 ? 1.0 / media : 0.0)
+            << "\nCiclos estimados: " << setprecision(0) << media * total;
+        if (n > 1) {
+            out << " +- " << meiaLargura * total << " (95% de confianca, +-" << setprecision(2)
+                << (media > 0 ? 100.0 * meiaLargura / media : 0.0) << "%)";
+            // Amostras para +-3% com a variabilidade observada
+            double necessarias = media > 0 ? pow(1.96 * desvio / (0.03 * media), 2) : 0.0;
+            out << "\nAmostras para +-3%: " << setprecision(0) << ceil(necessarias);
+        } else {
+            out << " (uma amostra: sem intervalo de confianca)";
+        }
+        out << "\n";
+        cout << out.str();
+    }
+
+    // Reprodução automática: a simulação roda nesta thread, a até
+    // ciclosPorSegundo ciclos por segundo (0 = sem pausa), e publica o estado
+    // de cada ciclo num AnelInstantaneos. A thread da interface desenha o mais
+    // novo a cada 1/quadrosPorSegundo s; os intermediários são descartados.
+    void reproduzir() {
+        typedef chrono::steady_clock Relogio;
+        Relogio::duration intervaloCiclo = ciclosPorSegundo > 0
+            ? chrono::duration_cast<Relogio::duration>(chrono::duration<double>(1.0 / ciclosPorSegundo))
+            : Relogio::duration::zero();
+        Relogio::duration intervaloQuadro =
+            chrono::duration_cast<Relogio::duration>(chrono::duration<double>(1.0 / quadrosPorSegundo));
+        AnelInstantaneos anel;
+
+        cout << "\x1b[?25l"; // esconde o cursor
+        thread desenho([&] {
+            Relogio::time_point proximoQuadro = Relogio::now();
+            while (true) {
+                this_thread::sleep_until(proximoQuadro);
+                proximoQuadro = max(proximoQuadro + intervaloQuadro, Relogio::now());
+                const Instantaneo* q = anel.maisNovo();
+                if (!q) continue;
+                bool fim = q->fim;
+                if (fim) desenharFim(*q);
+                else desenharQuadro(*q, "", "\n\n\n\nReproducao automatica (Ctrl+C interrompe)");
+                anel.liberar();
+                if (fim) break;
+            }
+        });
+
+        Relogio::time_point proximoCiclo = Relogio::now();
+        while (true) {
+            if (Instantaneo* q = anel.reservar()) {
+                capturar(*q, false);
+                anel.publicar();
+            } else {
+                anel.descartados++;
+            }
+            if (ciclosPorSegundo > 0) {
+                proximoCiclo += intervaloCiclo;
+                this_thread::sleep_until(proximoCiclo);
+            }
 
+            checkpointPeriodico();
+            executarCiclo();
+            if (!haTrabalhoPendente()) break;
             cicloAtual++;
-            system("cls");
         }
+
+        // O último quadro não pode ser descartado: espera a interface abrir espaço
+        Instantaneo* q;
+        while (!(q = anel.reservar())) this_thread::yield();
+        capturar(*q, true);
+        anel.publicar();
+        desenho.join();
+        cout << "\x1b[?25h";
+    }
+
+    // Entradas ocupadas do ROB, da cabeça (mais antiga) para a cauda
+    void mostrarROB(const Instantaneo& q) const {
+        tela.saida << "\n\nROB (" << q.robOcupadas << "/" << tamanhoROB << "): Entrada  Instrucao"
+                   << "                  Estado      Destino  Valor";
+        for (const Instantaneo::LinhaROB& ent : q.rob) {
+            tela.saida << "\n  " << left << setw(7) << ("ROB" + to_string(ent.entrada))
+                       << setw(27) << (to_string(ent.indiceInstrucao) + ". " +
+                                 descreverInstrucao(instrucoes[ent.indiceInstrucao]))
+                 << setw(12) << ent.estado
+                 << setw(9) << (ent.destReg >= 0 ? q.estadoRegistradores[ent.destReg].nomeRegistrador : "-")
+                 << (ent.pronto && ent.destReg >= 0 ? to_string(ent.valor) : "") << right;
+        }
+    }
+
+    // Resumo final do modo batch: ciclos, tabela de tempos e IPC
+    void mostrarResumo() const {
+        ostringstream out;
+        out << "Simulacao concluida no Ciclo " << cicloAtual << ".\n\n";
+        out << left << setw(28) << "Instrucao" << right
+            << setw(8) << "Emitido" << setw(8) << "Comeco"
+            << setw(8) << "Fim" << setw(9) << "Escrita" << setw(8) << "EspCDB";
+        if (tamanhoROB > 0) out << setw(8) << "Commit";
+        out << "\n";
+        for (int i = 0; i < numInstrucoes; i++) {
+            const StatusInstrucao& st = statusInstrucoes[i];
+            out << left << setw(28) << (to_string(i) + ". " + descreverInstrucao(instrucoes[i]))
+                << right
+                << setw(8) << (st.emitido == -1 ? "-" : to_string(st.emitido))
+                << setw(8) << (st.inicioExecucao == -1 ? "-" : to_string(st.inicioExecucao))
+                << setw(8) << (st.fimExecucao == -1 ? "-" : to_string(st.fimExecucao))
+                << setw(9) << (st.escritaResultado == -1 ? "-" : to_string(st.escritaResultado))
+                << setw(8) << (st.ciclosEsperaCDB == -1 ? "-" : to_string(st.ciclosEsperaCDB));
+            if (tamanhoROB > 0) out << setw(8) << (st.commit == -1 ? "-" : to_string(st.commit));
+            out << "\n";
+        }
+        double ipc = cicloAtual > 0 ? (double)instrucoesConcluidas / cicloAtual : 0.0;
+        out << "\nInstrucoes concluidas: " << instrucoesConcluidas
+            << "\nCiclos: " << cicloAtual
+            << "\nIPC: " << fixed << setprecision(3) << ipc << "\n";
+        if (retiradas.instancias > 0) {
+            double n = (double)retiradas.instancias;
+            out << "Instancias retiradas: " << retiradas.instancias
+                << " (media de ciclos: " << retiradas.somaEsperaOperandos / n << " ate executar, "
+                << retiradas.somaExecucao / n << " executando, "
+                << retiradas.somaAteEscrita / n << " da emissao a escrita)\n";
+        }
+
+        // Pilha de CPI: linhas por categoria, colunas pela classe da instrução
+        // que concluiu (base) ou da que deu a categoria ao ciclo
+        double cpi = instrucoesConcluidas > 0 ? (double)cicloAtual / instrucoesConcluidas : 0.0;
+        out << "\nPilha de CPI (CPI " << cpi << "):\n  " << left << setw(18) << "Categoria" << right
+            << setw(10) << "Ciclos" << setw(8) << "CPI";
+        for (int c = 0; c < NUM_CLASSES_INSTRUCAO; c++) out << setw(9) << NOMES_CLASSES_INSTRUCAO[c];
+        out << "\n";
+        for (int m = 0; m < NUM_CATEGORIAS_CICLO; m++) {
+            if (!pilhaCPI[m]) continue;
+            out << "  " << left << setw(18) << NOMES_CATEGORIAS_CICLO[m] << right
+                << setw(10) << pilhaCPI[m]
+                << setw(8) << (instrucoesConcluidas > 0 ? (double)pilhaCPI[m] / instrucoesConcluidas : 0.0);
+            for (int c = 0; c < NUM_CLASSES_INSTRUCAO; c++) out << setw(9) << pilhaCPIPorClasse[m][c];
+            out << "\n";
+        }
+
+        // Ciclos de cada unidade por estado do ocupante (base e front end não se aplicam)
+        out << "\nCiclos por unidade:  " << setw(8) << "Ocupada" << setw(10) << "Execucao"
+            << setw(8) << "RAW" << setw(9) << "Unidade" << setw(8) << "CDB"
+            << setw(9) << "Memoria" << setw(7) << "Banda" << setw(8) << "Commit" << "\n";
+        for (size_t t = 0; t < nomesUnidades.size(); t++) {
+            const array<long long, NUM_CATEGORIAS_CICLO>& c = ciclosPorUnidade[t];
+            long long ocupada = 0;
+            for (int m = 0; m < NUM_CATEGORIAS_CICLO; m++) ocupada += c[m];
+            out << "  " << left << setw(18) << nomesUnidades[t] << right << setw(8) << ocupada
+                << setw(10) << c[CICLO_EXECUCAO] << setw(8) << c[CICLO_DEPENDENCIA]
+                << setw(9) << c[CICLO_UNIDADE] << setw(8) << c[CICLO_CDB]
+                << setw(9) << c[CICLO_MEMORIA] << setw(7) << c[CICLO_BANDA]
+                << setw(8) << c[CICLO_COMMIT] << "\n";
+        }
+
+        out << "\nCDBs: " << numCDBs << " (" << NOMES_POLITICAS_CDB[politicaCDB] << ")"
+            << "\nEspera por CDB: total " << totalEsperaCDB << " ciclos, media "
+            << (escritasCDB ? (double)totalEsperaCDB / escritasCDB : 0.0)
+            << ", maxima " << maiorEsperaCDB << "\n";
+
+        long long totalSlots = (long long)larguraEmissao * cicloAtual;
+        long long semUso = 0;
+        for (int m = 0; m < NUM_MOTIVOS_SLOT; m++) semUso += slotsSemUso[m];
+        out << "\nLargura de emissao: " << larguraEmissao
+            << "\nSlots de emissao sem uso: " << semUso << " de " << totalSlots << "\n";
+        for (int m = 0; m < NUM_MOTIVOS_SLOT; m++)
+            if (slotsSemUso[m])
+                out << "  " << left << setw(18) << NOMES_MOTIVOS_SLOT[m] << right
+                    << setw(10) << slotsSemUso[m] << "\n";
+        out << "Ciclos por numero de emissoes:\n";
+        for (int k = 0; k <= larguraEmissao; k++)
+            out << "  " << k << ": " << slotsSemUsoPorEmitidas[k] << "\n";
+
+        bool limitado = false;
+        for (int g = 0; g < NUM_GRUPOS_FU; g++) limitado |= unidades[g].quantidade > 0;
+        if (limitado) {
+            out << "\nUnidades funcionais:   Qtde  Operacoes  Ocupacao  Esperas\n";
+            for (int g = 0; g < NUM_GRUPOS_FU; g++) {
+                const GrupoUnidades& grupo = unidades[g];
+                if (grupo.quantidade == 0) continue;
+                double ocupacao = cicloAtual > 0
+                    ? 100.0 * grupo.ciclosOcupados / ((double)grupo.quantidade * cicloAtual) : 0.0;
+                out << "  " << left << setw(18) << grupo.nome << right
+                    << setw(6) << grupo.quantidade << setw(11) << grupo.operacoes
+                    << setw(9) << ocupacao << "%" << setw(9) << grupo.esperas << "\n";
+            }
+        }
+
+        if (caches.ativa()) {
+            out << "\nCaches:  Tamanho  Assoc  Linha  Latencia   Subst   Acessos   Acertos    Falhas"
+                << "  Taxa falha  Writebacks\n";
+            for (const Cache& c : caches.niveis) {
+                if (c.tamanho == 0) continue;
+                long long falhas = c.acessos - c.acertos;
+                out << "  " << left << setw(4) << c.nome << right << setw(9) << c.tamanho
+                    << setw(7) << c.associatividade << setw(7) << c.tamanhoLinha
+                    << setw(10) << c.latencia << setw(8) << NOMES_POLITICAS_SUBST[c.politica]
+                    << setw(10) << c.acessos << setw(10) << c.acertos << setw(10) << falhas
+                    << setw(11) << (c.acessos ? 100.0 * falhas / c.acessos : 0.0) << "%"
+                    << setw(12) << c.writebacks << "\n";
+            }
+            out << "Memoria principal: " << caches.latenciaMemoria << " ciclos, "
+                << caches.acessosMemoria << " leituras, " << caches.escritasMemoria << " writebacks\n";
+            const Prefetcher& pf = caches.prefetcher;
+            if (pf.tipo != PREF_NENHUM) {
+                long long uteis = caches.prefetchsUteis(), inuteis = caches.prefetchsInuteis();
+                out << "\nPrefetcher: " << NOMES_PREFETCHERS[pf.tipo];
+                if (pf.tipo == PREF_STREAM)
+                    out << " (" << pf.numStreams << " buffers x " << pf.profundidade << " linhas)";
+                else
+                    out << " (grau " << pf.grau << ")";
+                out << "\nPrefetches emitidos: " << pf.emitidos << " (" << pf.semMSHR << " nao emitidos sem MSHR)"
+                    << "\nUteis: " << uteis << " (" << pf.atrasados << " atrasados)"
+                    << "\nInuteis (descartados sem uso): " << inuteis
+                    << ", nao usados ao fim: " << pf.emitidos - uteis - inuteis
+                    << "\nCobertura: " << (uteis + caches.falhasDemanda ? 100.0 * uteis / (uteis + caches.falhasDemanda) : 0.0)
+                    << "%\nPrecisao: " << (pf.emitidos ? 100.0 * uteis / pf.emitidos : 0.0) << "%\n";
+            }
+        }
+        if (caches.modelada()) {
+            const HierarquiaMemoria& h = caches;
+            out << "\nLado da memoria: portas " << (h.numPortas ? to_string(h.numPortas) : "sem limite")
+                << ", MSHRs " << (h.numMSHRs ? to_string(h.numMSHRs) : "sem limite")
+                << ", bancos " << (h.numBancos ? to_string(h.numBancos) + " (ocupados " +
+                                   to_string(h.ocupacaoBanco) + " ciclos)" : "nenhum")
+                << "\nEsperas por porta: " << h.esperasPorta << " (" << h.ciclosEsperaPorta << " ciclos)";
+            if (h.ativa())
+                out << "\nFalhas juntadas em MSHR: " << h.fusoesMSHR
+                    << "\nEsperas por MSHR: " << h.esperasMSHR << " (" << h.ciclosEsperaMSHR
+                    << " ciclos), pico de " << h.picoMSHRs << " falhas abertas";
+            out << "\nConflitos de banco: " << h.conflitosBanco << " (" << h.ciclosConflitoBanco << " ciclos)"
+                << "\nLatencia media de LOAD: "
+                << (loadsIniciados ? (double)somaLatenciaLoads / loadsIniciados : 0.0) << " ciclos\n";
+        }
+
+        if (tamanhoROB > 0) {
+            out << "\nROB: " << tamanhoROB << " entradas, preditor "
+                << NOMES_PREDITORES[preditor.tipo];
+            if (preditor.tipo != PRED_NAO_TOMADO) out << " (" << preditor.bitsTabela << " bits)";
+            out << "\nDesvios resolvidos: " << desviosResolvidos
+                << "\nPrevisoes erradas: " << desviosErrados
+                << "\nTaxa de acerto: "
+                << (desviosResolvidos ? 100.0 * (desviosResolvidos - desviosErrados) / desviosResolvidos : 100.0)
+                << "%\nInstrucoes descartadas: " << instrucoesDescartadas
+                << "\nCiclos de penalidade: " << ciclosPenalidade << "\n";
+            if (preditorMem.ativo)
+                out << "\nPreditor de dependencias: StoreSets (" << preditorMem.bits << " bits)"
+                    << "\nLOADs especulativos: " << loadsEspeculativos
+                    << "\nViolacoes de memoria: " << violacoesMemoria
+                    << "\nTaxa de acerto: "
+                    << (loadsEspeculativos ? 100.0 * (loadsEspeculativos - violacoesMemoria) / loadsEspeculativos : 100.0)
+                    << "%\nInstrucoes reexecutadas: " << instrucoesReexecutadas << "\n";
+        }
+        cout << out.str();
     }
 
     Tomasulo() {}
@@ -1227,28 +5246,640 @@ struct Tomasulo {
         delete[] estacoesAddSub;
         delete[] estacoesMultDiv;
         delete[] estadoRegistradores;
-        delete[] instrucoes;
+        delete[] programaProprio;
+        imagemPrograma.fechar();
+        delete[] statusInstrucoes;
+        delete[] rob;
+    }
+};
+
+// Gerador de cargas sintéticas no formato de entrada do simulador: um laço de
+// Iterations iterações sobre um corpo de Body_Size operações distribuídas em
+// ILP_Width cadeias de dependência independentes, cada uma reiniciada após
+// Chain_Depth operações encadeadas. Os sorteios usam mt19937 com Seed, então o
+// mesmo conjunto de parâmetros gera sempre o mesmo programa.
+struct GeradorCarga {
+    unsigned semente = 1;
+    int tamanhoCorpo = 32;
+    int iteracoes = 1000;
+    int largura = 2;
+    int profundidade = 8;
+    double fracaoMulDiv = 0.2;   // das operações aritméticas (1 em 4 é DIV)
+    double fracaoMemoria = 0.3;  // das operações do corpo (2 em 3 são LOAD)
+    double fracaoAlias = 0.1;    // acessos a um endereço já escrito na iteração
+    double fracaoDesvios = 0.05; // operações seguidas de um desvio para a frente
+    vector<pair<string, string>> configuracao; // chaves repassadas ao arquivo
+
+    // Registradores: F0 = 0, F1 = contador, F2 = ponteiro, F3 = 1, F4 = alternador
+    static const int PRIMEIRA_CADEIA = 5;
+
+    // "Chave=valor"; chaves que não são do gerador vão para a configuração
+    bool definir(const string& ajuste, string& erro) {
+        size_t eq = ajuste.find('=');
+        string chave = ajuste.substr(0, eq), valor = ajuste.substr(eq + 1);
+        double* fracao = chave == "Mul_Div_Ratio" ? &fracaoMulDiv
+                       : chave == "Load_Store_Ratio" ? &fracaoMemoria
+                       : chave == "Alias_Rate" ? &fracaoAlias
+                       : chave == "Branch_Rate" ? &fracaoDesvios : nullptr;
+        int* inteiro = chave == "Body_Size" ? &tamanhoCorpo
+                     : chave == "Iterations" ? &iteracoes
+                     : chave == "ILP_Width" ? &largura
+                     : chave == "Chain_Depth" ? &profundidade : nullptr;
+        if (fracao) {
+            try { *fracao = stod(valor); } catch (...) { *fracao = -1; }
+            if (*fracao < 0 || *fracao > 1) { erro = chave + " deve estar entre 0 e 1"; return false; }
+        } else if (inteiro || chave == "Seed") {
+            int v;
+            if (!converterInteiro(valor, v) || v < (chave == "Seed" ? 0 : 1)) {
+                erro = "valor invalido para " + chave;
+                return false;
+            }
+            if (inteiro) *inteiro = v; else semente = (unsigned)v;
+            if (largura > SEM_REGISTRADOR - 1 - PRIMEIRA_CADEIA) {
+                erro = "ILP_Width muito grande";
+                return false;
+            }
+        } else {
+            configuracao.push_back({ chave, valor });
+        }
+        return true;
+    }
+
+    string gerar() const {
+        mt19937 rng(semente);
+        auto sortear = [&]() { return rng() / 4294967296.0; };
+        auto escolher = [&](int n) { return (int)(rng() % (unsigned)n); };
+
+        ostringstream out;
+        out << "# Carga sintetica: Seed=" << semente << " Body_Size=" << tamanhoCorpo
+            << " Iterations=" << iteracoes << " ILP_Width=" << largura
+            << " Chain_Depth=" << profundidade << "\n# Mul_Div_Ratio=" << fracaoMulDiv
+            << " Load_Store_Ratio=" << fracaoMemoria << " Alias_Rate=" << fracaoAlias
+            << " Branch_Rate=" << fracaoDesvios << "\n";
+        for (const auto& c : configuracao) out << c.first << " " << c.second << "\n";
+        out << "Registers " << PRIMEIRA_CADEIA + largura << "\n"
+            << "F1 " << iteracoes << "\nF2 1024\nF3 1\n";
+        for (int c = 0; c < largura; c++) out << "F" << PRIMEIRA_CADEIA + c << " 1\n";
+
+        vector<int> encadeadas(largura, 0); // operações seguidas em cada cadeia
+        vector<int> escritos;               // offsets já escritos na iteração
+        int proximoOffset = 0;
+        int desvios = 0;
+        string rotuloPendente;              // rótulo da próxima instrução
+        string rotuloAposProxima;           // desvio para a frente: pula uma instrução
+        auto emitir = [&](const string& texto) {
+            out << (rotuloPendente.empty() ? "" : rotuloPendente + ":") << "\t" << texto << "\n";
+            rotuloPendente = rotuloAposProxima;
+            rotuloAposProxima.clear();
+        };
+
+        out << "laco:\n";
+        for (int i = 0; i < tamanhoCorpo; i++) {
+            int c = i % largura;
+            string r = "F" + to_string(PRIMEIRA_CADEIA + c);
+            if (sortear() < fracaoMemoria) {
+                bool alias = !escritos.empty() && sortear() < fracaoAlias;
+                int off = alias ? escritos[escolher((int)escritos.size())] : proximoOffset++;
+                if (escolher(3) < 2) {
+                    emitir("LOAD  " + r + ", " + to_string(off) + "(F2)");
+                    encadeadas[c] = 1;
+                } else {
+                    emitir("STORE " + r + ", " + to_string(off) + "(F2)");
+                    escritos.push_back(off);
+                }
+            } else if (encadeadas[c] >= profundidade) {
+                emitir("ADDI  " + r + ", F0, " + to_string(i % 7 + 1)); // quebra a cadeia
+                encadeadas[c] = 1;
+            } else {
+                const char* op = "ADD ";
+                if (sortear() < fracaoMulDiv) op = escolher(4) == 0 ? "DIV " : "MUL ";
+                else if (escolher(2)) op = "SUB ";
+                emitir(string(op) + "  " + r + ", " + r + ", F3");
+                encadeadas[c]++;
+            }
+            if (i + 1 < tamanhoCorpo && sortear() < fracaoDesvios) {
+                // Alterna F4 entre 0 e 1: em iterações alternadas o desvio é
+                // tomado e pula a próxima operação do corpo
+                emitir("SUB   F4, F3, F4");
+                string rotulo = "pula" + to_string(desvios++);
+                out << "\tBEQ   F4, F0, " << rotulo << "\n";
+                rotuloAposProxima = rotulo;
+            }
+        }
+        emitir("SUBI  F1, F1, 1");
+        out << "\tADDI  F2, F2, " << max(1, proximoOffset) << "\n"
+            << "\tBNE   F1, F0, laco\n";
+        return out.str();
+    }
+};
+
+// Conjunto fixo de cargas do --bench, todas sobre as latências do source.txt
+// de exemplo; ajustes da linha de comando valem para todas e vêm por último
+const char* const MAQUINA_BENCHMARK =
+    "Iterations=5000 Add_Sub_Cycles=2 Mul_Cycles=10 Div_Cycles=40 Load_Store_Cycles=2";
+
+struct CargaBenchmark {
+    const char* nome;
+    const char* parametros;
+};
+
+const CargaBenchmark CARGAS_BENCHMARK[] = {
+    { "serial",   "ILP_Width=1 Chain_Depth=1000 Load_Store_Ratio=0 Branch_Rate=0 Mul_Div_Ratio=0" },
+    { "ilp4",     "ILP_Width=4 Chain_Depth=8 Load_Store_Ratio=0 Branch_Rate=0 Mul_Div_Ratio=0" },
+    { "muldiv",   "ILP_Width=4 Chain_Depth=8 Load_Store_Ratio=0 Branch_Rate=0 Mul_Div_Ratio=0.5" },
+    { "memoria",  "ILP_Width=4 Chain_Depth=8 Load_Store_Ratio=0.5 Alias_Rate=0 Branch_Rate=0" },
+    { "aliasing", "ILP_Width=4 Chain_Depth=8 Load_Store_Ratio=0.5 Alias_Rate=0.5 Branch_Rate=0" },
+    { "desvios",  "ILP_Width=4 Chain_Depth=8 Load_Store_Ratio=0.2 Branch_Rate=0.25" },
+    { "misto",    "ILP_Width=3 Chain_Depth=6 Mul_Div_Ratio=0.2 Load_Store_Ratio=0.3 Alias_Rate=0.1 Branch_Rate=0.05" },
+};
+
+// Gera cada carga em memória, simula sem imprimir o resumo e mostra o IPC
+// simulado e a velocidade do simulador. Com 'diretorio', também grava cada
+// carga em diretorio/bench_<nome>.txt, para repetir com --batch.
+void executarBenchmark(const vector<string>& ajustes, const string& diretorio) {
+    cout << left << setw(10) << "Carga" << right << setw(12) << "Instrucoes" << setw(12) << "Ciclos"
+         << setw(8) << "IPC" << setw(10) << "Tempo(s)" << setw(14) << "Ciclos/s"
+         << setw(14) << "Instr/s" << "\n";
+    for (const CargaBenchmark& carga : CARGAS_BENCHMARK) {
+        GeradorCarga gerador;
+        istringstream parametros(string(MAQUINA_BENCHMARK) + " " + carga.parametros);
+        vector<string> todos;
+        string p;
+        while (parametros >> p) todos.push_back(p);
+        todos.insert(todos.end(), ajustes.begin(), ajustes.end());
+        for (const string& a : todos) {
+            string erro;
+            if (!gerador.definir(a, erro)) {
+                cout << erro << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+        string arquivo = string("bench_") + carga.nome + ".txt";
+        string texto = gerador.gerar();
+        if (!diretorio.empty()) {
+            arquivo = diretorio + "/" + arquivo;
+            ofstream saida(arquivo);
+            saida << texto;
+            if (!saida) {
+                cout << "Erro ao gravar " << arquivo << endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+
+        Tomasulo simulador;
+        simulador.modoBatch = true;
+        simulador.imprimirResumo = false;
+        simulador.carregarDadosDoTexto(arquivo, texto);
+        auto inicio = chrono::steady_clock::now();
+        simulador.Simular();
+        double segundos = chrono::duration<double>(chrono::steady_clock::now() - inicio).count();
+
+        long long ciclos = simulador.cicloAtual;
+        long long instrucoes = simulador.instrucoesConcluidas;
+        cout << left << setw(10) << carga.nome << right << setw(12) << instrucoes
+             << setw(12) << ciclos << setw(8) << fixed << setprecision(3)
+             << (ciclos ? (double)instrucoes / ciclos : 0.0) << setw(10) << segundos
+             << setw(14) << setprecision(0) << (segundos > 0 ? ciclos / segundos : 0.0)
+             << setw(14) << (segundos > 0 ? instrucoes / segundos : 0.0) << "\n";
+    }
+}
+
+// Pool de threads com roubo de trabalho: cada thread tem sua fila de índices
+// de tarefa, consome pela frente e, quando ela esvazia, rouba pelo fundo da
+// fila de outra. As tarefas não geram novas, então todas as filas vazias
+// significam fim.
+struct PoolRoubo {
+    struct Fila {
+        mutex trava;
+        deque<size_t> tarefas;
+    };
+
+    static void executar(size_t numTarefas, unsigned numThreads, const function<void(size_t)>& tarefa) {
+        numThreads = max(1u, (unsigned)min<size_t>(numThreads, max<size_t>(numTarefas, 1)));
+        vector<Fila> filas(numThreads);
+        for (size_t t = 0; t < numTarefas; t++) filas[t % numThreads].tarefas.push_back(t);
+
+        auto trabalhar = [&](unsigned eu) {
+            while (true) {
+                size_t t;
+                bool achou = false;
+                {
+                    lock_guard<mutex> trava(filas[eu].trava);
+                    if (!filas[eu].tarefas.empty()) {
+                        t = filas[eu].tarefas.front();
+                        filas[eu].tarefas.pop_front();
+                        achou = true;
+                    }
+                }
+                for (unsigned k = 1; !achou && k < numThreads; k++) {
+                    Fila& vitima = filas[(eu + k) % numThreads];
+                    lock_guard<mutex> trava(vitima.trava);
+                    if (!vitima.tarefas.empty()) {
+                        t = vitima.tarefas.back();
+                        vitima.tarefas.pop_back();
+                        achou = true;
+                    }
+                }
+                if (!achou) return;
+                tarefa(t);
+            }
+        };
+        vector<thread> threads;
+        for (unsigned i = 1; i < numThreads; i++) threads.emplace_back(trabalhar, i);
+        trabalhar(0);
+        for (thread& th : threads) th.join();
     }
 };
 
-int main() {
+// Um ponto da varredura: programa, valores das chaves varridas e resultado
+struct PontoVarredura {
+    string programa;
+    vector<pair<string, string>> ajustes;
+    long long ciclos = 0;
+    long long instrucoes = 0;
+    long long pilhaCPI[NUM_CATEGORIAS_CICLO] = {};
+};
+
+// Expande "ini:fim[:passo]" ou "a,b,c" na lista de valores de uma chave
+bool expandirValores(const string& texto, vector<string>& valores) {
+    if (texto.find(':') != string::npos) {
+        vector<int> partes;
+        size_t inicio = 0;
+        while (true) {
+            size_t fim = texto.find(':', inicio);
+            int v;
+            if (!converterInteiro(texto.substr(inicio, fim - inicio), v)) return false;
+            partes.push_back(v);
+            if (fim == string::npos) break;
+            inicio = fim + 1;
+        }
+        if (partes.size() > 3) return false;
+        int passo = partes.size() == 3 ? partes[2] : 1;
+        if (passo < 1 || partes[0] > partes[1]) return false;
+        for (long long v = partes[0]; v <= partes[1]; v += passo) valores.push_back(to_string(v));
+        return true;
+    }
+    size_t inicio = 0;
+    while (true) {
+        size_t fim = texto.find(',', inicio);
+        string v = texto.substr(inicio, fim - inicio);
+        if (v.empty()) return false;
+        valores.push_back(v);
+        if (fim == string::npos) break;
+        inicio = fim + 1;
+    }
+    return true;
+}
+
+// Campo de CSV entre aspas quando tem vírgula ou aspas
+string campoCSV(const string& s) {
+    if (s.find_first_of(",\"\n") == string::npos) return s;
+    string r = "\"";
+    for (char c : s) {
+        if (c == '"') r += '"';
+        r += c;
+    }
+    return r + "\"";
+}
+
+string textoJSON(const string& s) {
+    string r = "\"";
+    for (char c : s) {
+        if (c == '"' || c == '\\') r += '\\';
+        if ((unsigned char)c < 0x20) {
+            char buf[8];
+            snprintf(buf, sizeof buf, "\\u%04x", c);
+            r += buf;
+        } else
+            r += c;
+    }
+    return r + "\"";
+}
+
+// Nome de categoria da pilha de CPI como coluna ("dependencia RAW" -> "dependencia_RAW")
+string colunaCategoria(int c) {
+    string nome = NOMES_CATEGORIAS_CICLO[c];
+    replace(nome.begin(), nome.end(), ' ', '_');
+    return nome;
+}
+
+// Simula o produto cartesiano das chaves varridas para cada programa, cada
+// ponto numa instância própria de Tomasulo, e grava a tabela em CSV (ou em
+// JSON, se a saída termina em .json). Todos os pontos são carregados antes,
+// na thread principal, para que um erro de configuração encerre o programa
+// antes de qualquer simulação.
+void executarVarredura(const string& saida, const vector<string>& programas,
+                       const vector<string>& ajustes, unsigned numThreads) {
+    vector<string> chaves;
+    vector<vector<string>> valores;
+    for (const string& a : ajustes) {
+        size_t igual = a.find('=');
+        vector<string> lista;
+        if (!expandirValores(a.substr(igual + 1), lista)) {
+            cout << "Faixa invalida em " << a << " (use ini:fim[:passo] ou a,b,c)" << endl;
+            exit(EXIT_FAILURE);
+        }
+        chaves.push_back(a.substr(0, igual));
+        valores.push_back(lista);
+    }
+
+    vector<PontoVarredura> pontos;
+    vector<size_t> indice(chaves.size(), 0);
+    for (const string& programa : programas) {
+        fill(indice.begin(), indice.end(), 0);
+        while (true) {
+            PontoVarredura ponto;
+            ponto.programa = programa;
+            for (size_t k = 0; k < chaves.size(); k++) ponto.ajustes.emplace_back(chaves[k], valores[k][indice[k]]);
+            pontos.push_back(ponto);
+            // Avança o índice como um odômetro, a última chave mais rápido
+            size_t k = chaves.size();
+            while (k > 0 && ++indice[k - 1] == valores[k - 1].size()) indice[--k] = 0;
+            if (k == 0) break;
+        }
+    }
+
+    auto preparar = [](Tomasulo& simulador, const PontoVarredura& ponto) {
+        simulador.modoBatch = true;
+        simulador.imprimirResumo = false;
+        simulador.ajustesConfiguracao = ponto.ajustes;
+        simulador.carregarDadosDoArquivo(ponto.programa);
+    };
+    for (const PontoVarredura& ponto : pontos) {
+        Tomasulo simulador;
+        preparar(simulador, ponto);
+    }
+
+    auto inicio = chrono::steady_clock::now();
+    atomic<size_t> concluidos{0};
+    PoolRoubo::executar(pontos.size(), numThreads, [&](size_t t) {
+        PontoVarredura& ponto = pontos[t];
+        Tomasulo simulador;
+        preparar(simulador, ponto);
+        simulador.Simular();
+        ponto.ciclos = simulador.cicloAtual;
+        ponto.instrucoes = simulador.instrucoesConcluidas;
+        for (int c = 0; c < NUM_CATEGORIAS_CICLO; c++) ponto.pilhaCPI[c] = simulador.pilhaCPI[c];
+        concluidos++;
+    });
+    double segundos = chrono::duration<double>(chrono::steady_clock::now() - inicio).count();
+
+    ofstream out(saida);
+    bool json = saida.size() >= 5 && saida.compare(saida.size() - 5, 5, ".json") == 0;
+    out << fixed << setprecision(4);
+    if (json) out << "[\n";
+    else {
+        out << "programa";
+        for (const string& chave : chaves) out << "," << campoCSV(chave);
+        out << ",ciclos,instrucoes,ipc,cpi";
+        for (int c = 0; c < NUM_CATEGORIAS_CICLO; c++) out << "," << colunaCategoria(c);
+        out << "\n";
+    }
+    for (size_t i = 0; i < pontos.size(); i++) {
+        const PontoVarredura& p = pontos[i];
+        double ipc = p.ciclos ? (double)p.instrucoes / p.ciclos : 0.0;
+        double cpi = p.instrucoes ? (double)p.ciclos / p.instrucoes : 0.0;
+        if (json) {
+            out << "  {\"programa\": " << textoJSON(p.programa);
+            for (const auto& a : p.ajustes) {
+                int v;
+                out << ", " << textoJSON(a.first) << ": "
+                    << (converterInteiro(a.second, v) ? to_string(v) : textoJSON(a.second));
+            }
+            out << ", \"ciclos\": " << p.ciclos << ", \"instrucoes\": " << p.instrucoes
+                << ", \"ipc\": " << ipc << ", \"cpi\": " << cpi << ", \"pilha_cpi\": {";
+            for (int c = 0; c < NUM_CATEGORIAS_CICLO; c++)
+                out << (c ? ", " : "") << textoJSON(colunaCategoria(c)) << ": " << p.pilhaCPI[c];
+            out << "}}" << (i + 1 < pontos.size() ? "," : "") << "\n";
+        } else {
+            out << campoCSV(p.programa);
+            for (const auto& a : p.ajustes) out << "," << campoCSV(a.second);
+            out << "," << p.ciclos << "," << p.instrucoes << "," << ipc << "," << cpi;
+            for (int c = 0; c < NUM_CATEGORIAS_CICLO; c++) out << "," << p.pilhaCPI[c];
+            out << "\n";
+        }
+    }
+    if (json) out << "]\n";
+    if (!out) {
+        cout << "Erro ao gravar " << saida << endl;
+        exit(EXIT_FAILURE);
+    }
+    cout << "Varredura: " << concluidos << " pontos (" << programas.size() << " programa(s)) em "
+         << fixed << setprecision(2) << segundos << " s com " << min<size_t>(numThreads, max<size_t>(pontos.size(), 1)) << " thread(s) -> "
+         << saida << endl;
+}
+
+// Uso: source [--batch] [--sem-salto] [--auto [ciclos/s]] [--fps N]
+//              [--checkpoint N prefixo] [--restaurar arquivo.ckpt] [--avancar ciclo]
+//              [--salvar-programa saida.bin] [--funcional] [--amostragem N W [A]] [arquivo]
+//   --batch            executa sem interacao e imprime apenas o resumo final
+//   --sem-salto        no modo batch, simula ciclo a ciclo (sem pular ciclos ociosos)
+//   --auto             avanca os ciclos sem ENTER (padrao 10 ciclos/s; 0 = sem pausa)
+//   --fps              limite de redesenhos por segundo do --auto (padrao 30)
+//   --checkpoint       grava prefixo.<ciclo>.ckpt no inicio de cada ciclo multiplo de N
+//   --restaurar        continua a simulacao a partir de um checkpoint do mesmo arquivo
+//   --avancar          simula sem exibir ate o ciclo dado e so entao passa a desenhar
+//   --salvar-programa  grava o programa decodificado para uso com Program_Image
+//   --funcional        so executa o programa (emulacao funcional) e mostra o estado final
+//   --amostragem       a cada N instrucoes, simula em detalhe A de aquecimento (padrao W)
+//                      e mede W; o resto e emulado e o total de ciclos e estimado
+//        source --gerar saida.txt [Chave=valor ...]
+//   --gerar            grava uma carga sintetica (ver GeradorCarga) e sai
+//        source --bench [--salvar-cargas diretorio] [Chave=valor ...]
+//   --bench            simula o conjunto CARGAS_BENCHMARK e mede a velocidade
+//   --salvar-cargas    grava tambem cada carga em diretorio/bench_<nome>.txt
+//        source --varrer saida.csv|saida.json [--threads N] [Chave=faixa ...] arquivo [arquivo ...]
+//   --varrer           simula cada combinacao das faixas (ini:fim[:passo] ou a,b,c) para
+//                      cada arquivo, em paralelo, e grava ciclos, IPC e pilha de CPI
+//   --threads          threads da varredura (padrao: todos os nucleos)
+//   Chave=valor        parametros do gerador ou chaves de configuracao da maquina; numa
+//                      simulacao comum, sobrepoem as do arquivo
+int main(int argc, char* argv[]) {
+    bool batch = false;
+    bool salto = true;
+    bool automatico = false;
+    int ciclosPorSegundo = 10;
+    int quadrosPorSegundo = 30;
+    int intervaloCheckpoint = 0;
+    string prefixoCheckpoint;
+    string checkpointRestaurado;
+    int avancarAte = 0;
+    bool funcional = false;
+    long long periodoAmostragem = 0, janelaAmostragem = 0, aquecimentoAmostragem = -1;
+    string arquivo = "source.txt";
+    string programaBinario;
+    string cargaGerada;
+    bool benchmark = false;
+    string diretorioCargas;
+    string saidaVarredura;
+    unsigned threadsVarredura = max(1u, thread::hardware_concurrency());
+    vector<string> programas;
+    vector<string> ajustes;
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        if (arg == "--batch" || arg == "-b")
+            batch = true;
+        else if (arg == "--sem-salto")
+            salto = false;
+        else if (arg == "--auto") {
+            automatico = true;
+            int valor;
+            if (i + 1 < argc && converterInteiro(argv[i + 1], valor)) {
+                ciclosPorSegundo = max(0, valor);
+                i++;
+            }
+        } else if (arg == "--fps" && i + 1 < argc) {
+            if (!converterInteiro(argv[++i], quadrosPorSegundo) || quadrosPorSegundo < 1) {
+                cout << "Valor invalido para --fps: " << argv[i] << endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "--checkpoint" && i + 2 < argc) {
+            if (!converterInteiro(argv[++i], intervaloCheckpoint) || intervaloCheckpoint < 1) {
+                cout << "Valor invalido para --checkpoint: " << argv[i] << endl;
+                return EXIT_FAILURE;
+            }
+            prefixoCheckpoint = argv[++i];
+        } else if (arg == "--restaurar" && i + 1 < argc)
+            checkpointRestaurado = argv[++i];
+        else if (arg == "--avancar" && i + 1 < argc) {
+            if (!converterInteiro(argv[++i], avancarAte) || avancarAte < 1) {
+                cout << "Valor invalido para --avancar: " << argv[i] << endl;
+                return EXIT_FAILURE;
+            }
+        }
+        else if (arg == "--funcional")
+            funcional = true;
+        else if (arg == "--amostragem" && i + 2 < argc) {
+            int periodo, janela, aquecimento;
+            if (!converterInteiro(argv[i + 1], periodo) || !converterInteiro(argv[i + 2], janela) ||
+                periodo < 1 || janela < 1) {
+                cout << "Valores invalidos para --amostragem: " << argv[i + 1] << " " << argv[i + 2] << endl;
+                return EXIT_FAILURE;
+            }
+            periodoAmostragem = periodo;
+            janelaAmostragem = janela;
+            i += 2;
+            if (i + 1 < argc && converterInteiro(argv[i + 1], aquecimento)) {
+                if (aquecimento < 0) {
+                    cout << "Valor invalido para o aquecimento de --amostragem: " << argv[i + 1] << endl;
+                    return EXIT_FAILURE;
+                }
+                aquecimentoAmostragem = aquecimento;
+                i++;
+            }
+        }
+        else if (arg == "--salvar-programa" && i + 1 < argc)
+            programaBinario = argv[++i];
+        else if (arg == "--gerar" && i + 1 < argc)
+            cargaGerada = argv[++i];
+        else if (arg == "--bench")
+            benchmark = true;
+        else if (arg == "--salvar-cargas" && i + 1 < argc)
+            diretorioCargas = argv[++i];
+        else if (arg == "--varrer" && i + 1 < argc)
+            saidaVarredura = argv[++i];
+        else if (arg == "--threads" && i + 1 < argc) {
+            int valor;
+            if (!converterInteiro(argv[++i], valor) || valor < 1) {
+                cout << "Valor invalido para --threads: " << argv[i] << endl;
+                return EXIT_FAILURE;
+            }
+            threadsVarredura = valor;
+        }
+        else if (arg.find('=') != string::npos)
+            ajustes.push_back(arg);
+        else {
+            arquivo = arg;
+            programas.push_back(arg);
+        }
+    }
+
+    if (!cargaGerada.empty()) {
+        GeradorCarga gerador;
+        for (const string& a : ajustes) {
+            string erro;
+            if (!gerador.definir(a, erro)) {
+                cout << erro << endl;
+                return EXIT_FAILURE;
+            }
+        }
+        ofstream saida(cargaGerada);
+        saida << gerador.gerar();
+        if (!saida) {
+            cout << "Erro ao gravar " << cargaGerada << endl;
+            return EXIT_FAILURE;
+        }
+        return 0;
+    }
+    if (benchmark) {
+        executarBenchmark(ajustes, diretorioCargas);
+        return 0;
+    }
+    if (!saidaVarredura.empty()) {
+        if (programas.empty()) programas.push_back(arquivo);
+        executarVarredura(saidaVarredura, programas, ajustes, threadsVarredura);
+        return 0;
+    }
+    if (periodoAmostragem > 0) {
+        if (aquecimentoAmostragem < 0) aquecimentoAmostragem = janelaAmostragem;
+        if (aquecimentoAmostragem + janelaAmostragem > periodoAmostragem) {
+            cout << "--amostragem: aquecimento + janela deve caber no periodo" << endl;
+            return EXIT_FAILURE;
+        }
+    }
+    if ((funcional || periodoAmostragem > 0) &&
+        (intervaloCheckpoint > 0 || !checkpointRestaurado.empty() || avancarAte > 0)) {
+        cout << "--funcional e --amostragem nao combinam com --checkpoint, --restaurar ou --avancar" << endl;
+        return EXIT_FAILURE;
+    }
+    if (funcional || periodoAmostragem > 0) batch = true; // so o resumo final
+
 #if defined(_WIN32)
-    HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
-    SetConsoleTextAttribute(
-        hConsole,
-        FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE | FOREGROUND_INTENSITY
-    );
-    system("cls");
+    if (!batch) {
+        // O console do Windows só interpreta as sequências ANSI da Tela com este modo
+        HANDLE hConsole = GetStdHandle(STD_OUTPUT_HANDLE);
+        DWORD modo = 0;
+        GetConsoleMode(hConsole, &modo);
+        SetConsoleMode(hConsole, modo | ENABLE_VIRTUAL_TERMINAL_PROCESSING);
+        SetConsoleTextAttribute(
+            hConsole,
+            FOREGROUND_RED | FOREGROUND_GREEN | FOREGROUND_BLUE | FOREGROUND_INTENSITY
+        );
+    }
 #endif
 
     Tomasulo simulador;
-    simulador.carregarDadosDoArquivo("source.txt");
+    simulador.modoBatch = batch;
+    simulador.saltarCiclosOciosos = salto;
+    simulador.reproducaoAutomatica = automatico;
+    simulador.ciclosPorSegundo = ciclosPorSegundo;
+    simulador.quadrosPorSegundo = quadrosPorSegundo;
+    simulador.avancarAte = avancarAte;
+    simulador.intervaloCheckpoint = intervaloCheckpoint;
+    simulador.prefixoCheckpoint = prefixoCheckpoint;
+    simulador.modoFuncional = funcional;
+    simulador.periodoAmostragem = periodoAmostragem;
+    simulador.janelaAmostragem = janelaAmostragem;
+    simulador.aquecimentoAmostragem = aquecimentoAmostragem;
+    for (const string& a : ajustes) {
+        size_t igual = a.find('=');
+        simulador.ajustesConfiguracao.emplace_back(a.substr(0, igual), a.substr(igual + 1));
+    }
+    simulador.carregarDadosDoArquivo(arquivo);
+    if (!programaBinario.empty()) simulador.salvarPrograma(programaBinario);
+    if (!checkpointRestaurado.empty()) simulador.restaurarCheckpoint(checkpointRestaurado);
     simulador.Simular();
     return 0;
 }
 
-// posiciona cursor no console
-void irPara(short x, short y) {
-    COORD c = { x, y };
-    SetConsoleCursorPosition(GetStdHandle(STD_OUTPUT_HANDLE), c);
+// posiciona o cursor no quadro da Tela (coluna x, linha y)
+void irPara(int x, int y) {
+    tela.posicionar(x, y);
+}
+
+// espera ENTER antes de sair, para a mensagem nao sumir com a janela
+void pausar() {
+    cout << "Pressione ENTER para continuar...";
+    cin.get();
 }
@@ -0,0 +1,58 @@
+#!/bin/sh
+# Regressoes do modo batch sobre cargas sinteticas do --gerar:
+#   - pular ciclos ociosos (padrao) imprime o mesmo que --sem-salto
+#   - continuar de cada checkpoint imprime o mesmo que a execucao inteira
+# Uso: ./verificar.sh [executavel]   (padrao: ./source)
+# Sai com status 1 se alguma saida diferir.
+
+EXE=${1:-./source}
+DIR=$(mktemp -d) || exit 1
+trap 'rm -rf "$DIR"' EXIT
+
+falhas=0
+n=0
+while read -r parametros; do
+    n=$((n + 1))
+    carga="$DIR/carga$n.txt"
+    # $parametros tem varios Chave=valor: separados de proposito
+    "$EXE" --gerar "$carga" Iterations=150 Add_Sub_Cycles=2 Mul_Cycles=10 Div_Cycles=40 \
+        Load_Store_Cycles=2 $parametros || exit 1
+    "$EXE" --batch "$carga" > "$DIR/inteira.out"
+
+    "$EXE" --batch --sem-salto "$carga" > "$DIR/sem-salto.out"
+    if ! cmp -s "$DIR/inteira.out" "$DIR/sem-salto.out"; then
+        echo "carga $n: --sem-salto DIFERENTE ($parametros)"
+        falhas=$((falhas + 1))
+    fi
+
+    rm -f "$DIR"/ck.*.ckpt
+    "$EXE" --batch --checkpoint 97 "$DIR/ck" "$carga" > "$DIR/gravando.out"
+    if ! cmp -s "$DIR/inteira.out" "$DIR/gravando.out"; then
+        echo "carga $n: --checkpoint mudou a saida ($parametros)"
+        falhas=$((falhas + 1))
+    fi
+    restauracoes=0
+    for ck in "$DIR"/ck.*.ckpt; do
+        [ -e "$ck" ] || continue
+        restauracoes=$((restauracoes + 1))
+        "$EXE" --batch --restaurar "$ck" "$carga" > "$DIR/restaurada.out"
+        if ! cmp -s "$DIR/inteira.out" "$DIR/restaurada.out"; then
+            echo "carga $n: --restaurar $(basename "$ck") DIFERENTE ($parametros)"
+            falhas=$((falhas + 1))
+        fi
+    done
+    echo "carga $n: $(grep -m1 '^Ciclos:' "$DIR/inteira.out"), $restauracoes checkpoint(s) restaurado(s)"
+done <<EOF
+Seed=1 ILP_Width=1 Chain_Depth=40 Load_Store_Ratio=0 Branch_Rate=0
+Seed=2 ILP_Width=4 Mul_Div_Ratio=0.4 Load_Store_Ratio=0.2 Branch_Rate=0
+Seed=3 ILP_Width=4 Load_Store_Ratio=0.5 Alias_Rate=0.5 Branch_Rate=0
+Seed=4 Load_Store_Ratio=0.3 Branch_Rate=0.25 ROB_Size=16 Issue_Width=2 Branch_Predictor=GShare
+Seed=5 Load_Store_Ratio=0.5 Alias_Rate=0.3 Branch_Rate=0.1 ROB_Size=32 Memory_Dependence_Predictor=StoreSets
+Seed=6 Load_Store_Ratio=0.5 Alias_Rate=0.1 ROB_Size=32 L1_Size=16 L1_Line_Size=4 Prefetcher=Stride
+EOF
+
+if [ "$falhas" -ne 0 ]; then
+    echo "$falhas diferenca(s)"
+    exit 1
+fi
+echo "todas as saidas conferem"